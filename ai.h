@@ -0,0 +1,245 @@
+// BlockBreaker - Monte Carlo tree search paddle AI
+//
+// Plans paddle moves by searching over short fixed-length actions: each one
+// holds the paddle at the predicted landing point plus one of a few offsets,
+// which decides the angle the ball leaves the paddle at. Every worker thread
+// grows its own tree from a snapshot of the live game (root parallelism),
+// replaying actions on a private copy with restore(), and the root visit
+// counts are summed across workers once the time budget runs out.
+
+#ifndef BLOCKBREAKER_AI_H
+#define BLOCKBREAKER_AI_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "game.h"
+#include "threadpool.h"
+
+// The first ball's predicted landing x, recomputed only when the ball starts
+// a new straight leg
+class LandingTracker {
+private:
+    double dx = 0, dy = 0, offset = 0;  // The leg the prediction was made for
+    double landingX = 0;
+
+public:
+    double landing(const BlockBreakerGame& game) {
+        const Ball& ball = game.getBalls().front();
+        double lineOffset = ball.x * ball.dy - ball.y * ball.dx;  // Constant along a leg
+        if (ball.dx != dx || ball.dy != dy || std::abs(lineOffset - offset) > 1e-6) {
+            dx = ball.dx;
+            dy = ball.dy;
+            offset = lineOffset;
+            landingX = game.predictLanding().x;
+        }
+        return landingX;
+    }
+};
+
+// Simple scripted player: parks the paddle at the predicted landing point,
+// shifted off the paddle's center so returns go out at an angle. The shift
+// cycles with the score so it does not lock the ball into one path.
+class LandingBot {
+private:
+    LandingTracker tracker;
+
+public:
+    double target(const BlockBreakerGame& game) {
+        int lane = (game.getScore() / 10) % 5 - 2;  // -2 .. 2
+        return tracker.landing(game) - lane * (PADDLE_WIDTH / 6.0);
+    }
+};
+
+struct MctsStats {
+    uint64_t iterations = 0;        // Tree descents plus rollouts
+    uint64_t simulatedTicks = 0;    // update() calls across all workers
+    double seconds = 0;
+};
+
+class MctsPlayer {
+public:
+    static const int ACTIONS = 5;
+    static const int ACTION_TICKS = 8;      // How long one action holds the paddle
+    static const int HORIZON_ACTIONS = 30;  // Search depth plus rollout, in actions
+
+private:
+    struct Node {
+        int firstChild;     // -1 until expanded; children are consecutive
+        int action;
+        uint32_t visits;
+        double value;       // Sum of rewards through this node
+    };
+
+    struct Worker {
+        std::unique_ptr<BlockBreakerGame> game;  // Private copy of the level
+        uint32_t level = 0;                      // levelSerial() the copy was taken at
+        std::vector<Node> tree;
+        Rng rng;
+        LandingTracker tracker;
+        MctsStats stats;
+    };
+
+    ThreadPool pool;
+    std::vector<Worker> workers;
+    MctsStats last;
+
+    static double actionOffset(int action) {
+        return (action - ACTIONS / 2) * (PADDLE_WIDTH / 6.0);
+    }
+
+    // Run one action on the worker's game; false once the game is over
+    static bool play(Worker& worker, int action) {
+        BlockBreakerGame& game = *worker.game;
+        for (int tick = 0; tick < ACTION_TICKS && !game.isGameOver(); tick++) {
+            game.movePaddle(worker.tracker.landing(game) + actionOffset(action));
+            game.update();
+            if (!game.isGameRunning() && !game.isGameOver()) {
+                game.start();  // Serve again straight away after a lost life
+            }
+            worker.stats.simulatedTicks++;
+        }
+        return !game.isGameOver();
+    }
+
+    // Blocks broken, with lost lives and winning weighted heavily
+    static double reward(const GameSnapshot& root, const BlockBreakerGame& game) {
+        double value = (game.getScore() - root.score) / 10.0;
+        value -= 10.0 * (root.lives - game.getLives());
+        if (game.isGameOver() && game.getLives() > 0) value += 20.0;
+        return value;
+    }
+
+    // One descent: select by UCT, expand a leaf, finish with a random rollout
+    // and back the reward up the path
+    static void iterate(Worker& worker, const GameSnapshot& root) {
+        std::vector<Node>& tree = worker.tree;
+        worker.game->restore(root);
+        worker.stats.iterations++;
+
+        int path[HORIZON_ACTIONS + 1];
+        int depth = 0;
+        int node = 0;
+        path[depth++] = node;
+        bool running = true;
+        while (running && tree[node].firstChild >= 0) {
+            const Node& parent = tree[node];
+            double logVisits = std::log(static_cast<double>(parent.visits));
+            int best = parent.firstChild;
+            double bestScore = -1e300;
+            for (int c = parent.firstChild; c < parent.firstChild + ACTIONS; c++) {
+                const Node& child = tree[c];
+                // Rewards span roughly ten blocks, which sets the exploration scale
+                double score = child.visits == 0 ? 1e300
+                             : child.value / child.visits + 10.0 * std::sqrt(2.0 * logVisits / child.visits);
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = c;
+                }
+            }
+            node = best;
+            path[depth++] = node;
+            running = play(worker, tree[node].action);
+        }
+
+        // Expand a leaf that has been visited before and take its first child
+        if (running && tree[node].visits > 0 && depth <= HORIZON_ACTIONS) {
+            int first = static_cast<int>(tree.size());
+            tree[node].firstChild = first;
+            for (int a = 0; a < ACTIONS; a++) {
+                tree.push_back({-1, a, 0, 0.0});
+            }
+            node = first;
+            path[depth++] = node;
+            running = play(worker, tree[node].action);
+        }
+
+        for (int step = depth - 1; running && step < HORIZON_ACTIONS; step++) {
+            running = play(worker, worker.rng.below(ACTIONS));
+        }
+
+        double value = reward(root, *worker.game);
+        for (int i = 0; i < depth; i++) {
+            tree[path[i]].visits++;
+            tree[path[i]].value += value;
+        }
+    }
+
+public:
+    // threads counts the calling thread, as for ThreadPool
+    explicit MctsPlayer(unsigned threads = std::thread::hardware_concurrency())
+        : pool(std::max(1u, threads)), workers(pool.size()) {
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].rng.reseed(0x5eed + i);
+        }
+    }
+
+    // Search from the game's current state and return where to put the
+    // paddle this tick. The search runs for budgetMs milliseconds, or for
+    // exactly maxIterations descents per thread when that is nonzero, which
+    // makes the choice independent of machine speed.
+    double decide(const BlockBreakerGame& game, double budgetMs, uint64_t maxIterations = 0) {
+        GameSnapshot root;
+        if (!game.save(root)) {
+            return game.getBalls().front().x;  // Too many balls to search; just follow
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::duration<double, std::milli>(budgetMs);
+
+        pool.run(workers.size(), [&](size_t index) {
+            Worker& worker = workers[index];
+            // Take the level over again when a new one has started, and every
+            // time in endless mode, where the blocks scroll between decisions;
+            // only the simulation state, never the render caches
+            bool fresh = !worker.game;
+            if (fresh) worker.game = std::make_unique<BlockBreakerGame>();
+            if (fresh || worker.level != game.levelSerial() || game.isEndless()) {
+                worker.game->copyLevel(game);
+                worker.level = game.levelSerial();
+            }
+            worker.game->restore(root);
+            worker.tree.clear();
+            worker.tree.push_back({-1, 0, 0, 0.0});
+            uint64_t iterations = 0;
+            do {
+                iterate(worker, root);
+            } while (maxIterations ? ++iterations < maxIterations : std::chrono::steady_clock::now() < deadline);
+        });
+
+        // Most visited action over all workers' roots
+        uint32_t visits[ACTIONS] = {};
+        last = MctsStats();
+        for (Worker& worker : workers) {
+            const Node& rootNode = worker.tree[0];
+            if (rootNode.firstChild >= 0) {
+                for (int a = 0; a < ACTIONS; a++) {
+                    visits[a] += worker.tree[rootNode.firstChild + a].visits;
+                }
+            }
+            last.iterations += worker.stats.iterations;
+            last.simulatedTicks += worker.stats.simulatedTicks;
+            worker.stats = MctsStats();
+        }
+        last.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int best = ACTIONS / 2;
+        for (int a = 0; a < ACTIONS; a++) {
+            if (visits[a] > visits[best]) best = a;
+        }
+        return game.predictLanding().x + actionOffset(best);
+    }
+
+    // Work done by the last decide()
+    const MctsStats& lastStats() const {
+        return last;
+    }
+
+    unsigned threads() const {
+        return pool.size();
+    }
+};
+
+#endif // BLOCKBREAKER_AI_H
@@ -11,464 +11,154 @@
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
 
-// Game constants
-const int WINDOW_WIDTH = 800;
-const int WINDOW_HEIGHT = 600;
-const int PADDLE_WIDTH = 100;
-const int PADDLE_HEIGHT = 20;
-const int BALL_RADIUS = 10;
-const int BLOCK_WIDTH = 80;
-const int BLOCK_HEIGHT = 30;
-const int BLOCK_ROWS = 5;
-const int BLOCK_COLS = 9;
-const int BLOCK_SPACING = 5;
-const int TOP_MARGIN = 50;
-const int SIDE_MARGIN = 20;
-const double BALL_SPEED = 5.0;
+#include "game.h"
+#include "ai.h"
+#include "shm.h"
+#include "cpu.h"
+#include "level.h"
+#include "pack.h"
+#include "prefetch.h"
+#include "endless.h"
 
-// Game objects
-struct Ball {
-    double x, y;
-    double dx, dy;
-    int radius;
-    
-    Ball(double startX, double startY, int r) : x(startX), y(startY), radius(r) {
-        // Initial direction: upward at an angle
-        double angle = M_PI / 4.0;  // 45 degrees
-        dx = BALL_SPEED * cos(angle);
-        dy = -BALL_SPEED * sin(angle);
-    }
-    
-    void move() {
-        x += dx;
-        y += dy;
-    }
-    
-    void draw(cairo_t* cr) {
-        // Create gradient for 3D effect
-        cairo_pattern_t *gradient = cairo_pattern_create_radial(
-            x - radius/3, y - radius/3, 0,
-            x, y, radius
-        );
-        cairo_pattern_add_color_stop_rgb(gradient, 0.0, 1.0, 1.0, 0.5);  // Bright center
-        cairo_pattern_add_color_stop_rgb(gradient, 0.7, 1.0, 0.8, 0.0);  // Regular yellow
-        cairo_pattern_add_color_stop_rgb(gradient, 1.0, 0.8, 0.6, 0.0);  // Darker edge
-        
-        // Draw ball with gradient
-        cairo_arc(cr, x, y, radius, 0, 2 * M_PI);
-        cairo_set_source(cr, gradient);
-        cairo_fill(cr);
-        cairo_pattern_destroy(gradient);
-        
-        // Add highlight reflection
-        cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.3);
-        cairo_arc(cr, x - radius/3, y - radius/3, radius/3, 0, 2 * M_PI);
-        cairo_fill(cr);
-    }
-};
+// GTK application
+BlockBreakerGame game;
+GtkWidget* window;
+GtkWidget* drawingArea;
+QualityGovernor governor;
+double updateMs = 0;  // Time spent in the last game.update(), charged to the next frame
 
-struct Paddle {
-    double x, y;
-    int width, height;
-    
-    Paddle(double startX, double startY, int w, int h) 
-        : x(startX), y(startY), width(w), height(h) {}
-    
-    void draw(cairo_t* cr) {
-        // Create gradient for 3D effect
-        cairo_pattern_t *gradient = cairo_pattern_create_linear(
-            x - width/2, y - height/2, 
-            x + width/2, y + height/2
-        );
-        cairo_pattern_add_color_stop_rgb(gradient, 0.0, 0.2, 0.8, 1.0);  // Lighter blue top
-        cairo_pattern_add_color_stop_rgb(gradient, 1.0, 0.0, 0.4, 0.8);  // Darker blue bottom
-        
-        // Main paddle body with gradient
-        cairo_rectangle(cr, x - width/2, y - height/2, width, height);
-        cairo_set_source(cr, gradient);
-        cairo_fill_preserve(cr);
-        cairo_pattern_destroy(gradient);
-        
-        // Add top and left highlight
-        cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.5);
-        cairo_set_line_width(cr, 2);
-        cairo_move_to(cr, x - width/2, y + height/2);
-        cairo_line_to(cr, x - width/2, y - height/2);
-        cairo_line_to(cr, x + width/2, y - height/2);
-        cairo_stroke(cr);
-        
-        // Add bottom and right shadow
-        cairo_set_source_rgba(cr, 0.0, 0.0, 0.3, 0.5);
-        cairo_move_to(cr, x + width/2, y - height/2);
-        cairo_line_to(cr, x + width/2, y + height/2);
-        cairo_line_to(cr, x - width/2, y + height/2);
-        cairo_stroke(cr);
-        
-        // Add inner bevel for extra 3D effect
-        cairo_set_source_rgba(cr, 0.1, 0.6, 0.9, 1.0);
-        cairo_rectangle(cr, x - width/2 + 3, y - height/2 + 3, width - 6, height - 6);
-        cairo_fill(cr);
-    }
-    
-    void move(double newX) {
-        // Ensure paddle stays within window bounds
-        if (newX - width / 2 < 0) {
-            x = width / 2;
-        } else if (newX + width / 2 > WINDOW_WIDTH) {
-            x = WINDOW_WIDTH - width / 2;
-        } else {
-            x = newX;
-        }
-    }
-};
+// Attract mode: the MCTS player drives the paddle and restarts games itself
+const double AI_BUDGET_MS = 6;     // Search time per tick, leaving room to draw
+const int AI_RESTART_TICKS = 120;  // Pause on the game over screen
+std::unique_ptr<MctsPlayer> autopilot;
+int gameOverTicks = 0;
 
-struct Block {
-    double x, y;
-    int width, height;
-    bool active;
-    double r, g, b;  // Color
-    
-    Block(double startX, double startY, int w, int h) 
-        : x(startX), y(startY), width(w), height(h), active(true) {
-        // Assign a random color
-        r = 0.3 + (rand() % 70) / 100.0;
-        g = 0.3 + (rand() % 70) / 100.0;
-        b = 0.3 + (rand() % 70) / 100.0;
-    }
-    
-    void draw(cairo_t* cr) {
-        if (!active) return;
-        
-        // Create a gradient for 3D effect
-        cairo_pattern_t *gradient = cairo_pattern_create_linear(x, y, x + width, y + height);
-        cairo_pattern_add_color_stop_rgb(gradient, 0.0, r * 1.2 > 1.0 ? 1.0 : r * 1.2, 
-                                                     g * 1.2 > 1.0 ? 1.0 : g * 1.2, 
-                                                     b * 1.2 > 1.0 ? 1.0 : b * 1.2);  // Lighter top-left
-        cairo_pattern_add_color_stop_rgb(gradient, 1.0, r * 0.7, g * 0.7, b * 0.7);  // Darker bottom-right
-        
-        // Draw block main body with gradient
-        cairo_rectangle(cr, x, y, width, height);
-        cairo_set_source(cr, gradient);
-        cairo_fill_preserve(cr);
-        cairo_pattern_destroy(gradient);
-        
-        // Add highlight on top and left edges
-        cairo_set_source_rgba(cr, 1, 1, 1, 0.5);  // Brighter light border
-        cairo_set_line_width(cr, 2);
-        cairo_move_to(cr, x, y + height);
-        cairo_line_to(cr, x, y);
-        cairo_line_to(cr, x + width, y);
-        cairo_stroke(cr);
-        // Add shadow on bottom and right edges
-        cairo_set_source_rgba(cr, 0, 0, 0, 0.5);  // Darker shadow border
-        cairo_move_to(cr, x + width, y);
-        cairo_line_to(cr, x + width, y + height);
-        cairo_line_to(cr, x, y + height);
-        cairo_stroke(cr);
-        
-        // Add inner bevel for extra 3D effect
-        cairo_set_source_rgba(cr, r * 0.8, g * 0.8, b * 0.8, 1.0);
-        cairo_rectangle(cr, x + 3, y + 3, width - 6, height - 6);
-        cairo_fill(cr);
-    }
-};
+// Optional live state export for external readers
+StatePublisher statePublisher;
+uint64_t tickCount = 0;
 
-// Game class
-class BlockBreakerGame {
-private:
-    std::unique_ptr<Ball> ball;
-    std::unique_ptr<Paddle> paddle;
-    std::vector<Block> blocks;
-    bool gameRunning;
-    bool gameOver;
-    int score;
-    int lives;
-    
-public:
-    BlockBreakerGame() : gameRunning(false), gameOver(false), score(0), lives(3) {
-        resetGame();
-    }
-    
-    void resetGame() {
-        // Initialize ball
-        ball = std::make_unique<Ball>(WINDOW_WIDTH / 2, WINDOW_HEIGHT - 50, BALL_RADIUS);
-        
-        // Initialize paddle
-        paddle = std::make_unique<Paddle>(WINDOW_WIDTH / 2, WINDOW_HEIGHT - 30, PADDLE_WIDTH, PADDLE_HEIGHT);
-        
-        // Initialize blocks
-        blocks.clear();
-        for (int row = 0; row < BLOCK_ROWS; row++) {
-            for (int col = 0; col < BLOCK_COLS; col++) {
-                double blockX = SIDE_MARGIN + col * (BLOCK_WIDTH + BLOCK_SPACING);
-                double blockY = TOP_MARGIN + row * (BLOCK_HEIGHT + BLOCK_SPACING);
-                blocks.emplace_back(blockX, blockY, BLOCK_WIDTH, BLOCK_HEIGHT);
-            }
-        }
-        
-        gameRunning = false;
-        gameOver = false;
-    }
-    
-    void start() {
-        gameRunning = true;
-    }
-    
-    void movePaddle(double x) {
-        paddle->move(x);
-        
-        // If game hasn't started, move the ball with the paddle
-        if (!gameRunning && !gameOver) {
-            ball->x = paddle->x;
-        }
-    }
-    
-    bool update() {
-        if (!gameRunning || gameOver) return true;
-        
-        // Move the ball
-        ball->move();
-        
-        // Check for collisions with walls
-        if (ball->x - ball->radius <= 0) {
-            ball->x = ball->radius; // Prevent getting stuck on left wall
-            ball->dx = std::abs(ball->dx); // Force moving right
-        } else if (ball->x + ball->radius >= WINDOW_WIDTH) {
-            ball->x = WINDOW_WIDTH - ball->radius; // Prevent getting stuck on right wall
-            ball->dx = -std::abs(ball->dx); // Force moving left
-        }
-        
-        if (ball->y - ball->radius <= 0) {
-            ball->y = ball->radius; // Prevent getting stuck on top wall
-            ball->dy = std::abs(ball->dy); // Force moving down
-        }
-        
-        // Check for collision with paddle
-        if (ball->y + ball->radius >= paddle->y - paddle->height / 2 &&
-            ball->y - ball->radius <= paddle->y + paddle->height / 2 &&
-            ball->x >= paddle->x - paddle->width / 2 &&
-            ball->x <= paddle->x + paddle->width / 2) {
-            
-            // Calculate reflection angle based on where the ball hit the paddle
-            double hitPos = (ball->x - paddle->x) / (paddle->width / 2);  // -1 to 1
-            double angle = hitPos * (M_PI / 3);  // -60 to 60 degrees
-            
-            ball->dy = -std::abs(ball->dy);  // Always bounce upward
-            
-            // Adjust horizontal direction based on hit position
-            double speed = std::sqrt(ball->dx * ball->dx + ball->dy * ball->dy);
-            ball->dx = speed * std::sin(angle);
-            ball->dy = -speed * std::cos(angle);
-        }
-        
-        // Check for collisions with blocks
-        for (auto& block : blocks) {
-            if (!block.active) continue;
-            
-            bool collision = false;
-            double collisionSide = 0; // 0=top, 1=right, 2=bottom, 3=left
-            double overlapX = 0, overlapY = 0;
-            
-            // Calculate the closest point on the block to the ball
-            double closestX = std::max(block.x, std::min(ball->x, block.x + block.width));
-            double closestY = std::max(block.y, std::min(ball->y, block.y + block.height));
-            
-            // Calculate the distance between the ball and the closest point
-            double distanceX = ball->x - closestX;
-            double distanceY = ball->y - closestY;
-            double distanceSquared = distanceX * distanceX + distanceY * distanceY;
-            
-            // Check if the distance is less than the ball's radius
-            if (distanceSquared < ball->radius * ball->radius) {
-                collision = true;
-                
-                // Determine which side of the block was hit
-                // Based on the ball's position and velocity
-                double ball_right = ball->x + ball->radius;
-                double ball_left = ball->x - ball->radius;
-                double ball_top = ball->y - ball->radius;
-                double ball_bottom = ball->y + ball->radius;
-                double block_right = block.x + block.width;
-                double block_left = block.x;
-                double block_top = block.y;
-                double block_bottom = block.y + block.height;
-                
-                // Calculate time of collision with each side
-                double t_left = (ball->dx > 0) ? (block_left - ball_right) / ball->dx : INFINITY;
-                double t_right = (ball->dx < 0) ? (block_right - ball_left) / ball->dx : INFINITY;
-                double t_top = (ball->dy > 0) ? (block_top - ball_bottom) / ball->dy : INFINITY;
-                double t_bottom = (ball->dy < 0) ? (block_bottom - ball_top) / ball->dy : INFINITY;
-                
-                // Find the earliest collision
-                double t = std::min(std::min(t_left, t_right), std::min(t_top, t_bottom));
-                
-                if (t == t_left) collisionSide = 3;
-                else if (t == t_right) collisionSide = 1;
-                else if (t == t_top) collisionSide = 0;
-                else collisionSide = 2;
-                
-                // Alternative approach if the above time-based approach is unstable
-                // Determine impact side by checking where the closest point is on the block
-                if (closestX == block.x) collisionSide = 3; // Left side
-                else if (closestX == block.x + block.width) collisionSide = 1; // Right side
-                else if (closestY == block.y) collisionSide = 0; // Top side
-                else collisionSide = 2; // Bottom side
-            }
-            
-            if (collision) {
-                block.active = false;
-                score += 10;
-                
-                // Change direction based on which side was hit
-                switch (static_cast<int>(collisionSide)) {
-                    case 0: // Top
-                    case 2: // Bottom
-                        ball->dy = -ball->dy;
-                        // Add a slight random horizontal angle variation to make gameplay more interesting
-                        ball->dx += ((rand() % 100) / 500.0) - 0.1;
-                        break;
-                    case 1: // Right
-                    case 3: // Left
-                        ball->dx = -ball->dx;
-                        // Add a slight random vertical angle variation
-                        ball->dy += ((rand() % 100) / 500.0) - 0.1;
-                        break;
-                }
-                
-                // Normalize speed to keep it consistent
-                double speed = std::sqrt(ball->dx * ball->dx + ball->dy * ball->dy);
-                ball->dx = (ball->dx / speed) * BALL_SPEED;
-                ball->dy = (ball->dy / speed) * BALL_SPEED;
-                
-                break;  // Only one collision per frame
-            }
-        }
-        
-        // Check if ball falls below the screen
-        if (ball->y - ball->radius > WINDOW_HEIGHT) {
-            lives--;
-            if (lives <= 0) {
-                gameOver = true;
-            } else {
-                // Reset ball position
-                ball->x = paddle->x;
-                ball->y = WINDOW_HEIGHT - 50;
-                ball->dx = BALL_SPEED * cos(M_PI / 4.0);
-                ball->dy = -BALL_SPEED * sin(M_PI / 4.0);
-                gameRunning = false;
-            }
-        }
-        
-        // Check if all blocks are destroyed
-        bool allBlocksDestroyed = true;
-        for (const auto& block : blocks) {
-            if (block.active) {
-                allBlocksDestroyed = false;
-                break;
-            }
-        }
-        
-        if (allBlocksDestroyed) {
-            gameOver = true;  // Player wins
+// Level file to play instead of the standard level (--level)
+LevelFile levelFile;
+
+// Campaign: the levels of a pack in order (--pack), moving on when one is won
+LevelPack levelPack;
+size_t campaignLevel = 0;
+
+// Name the campaign level in the title bar, once there is a window
+static void showCampaignLevel() {
+    if (!window) return;
+    const LevelPackEntry& entry = levelPack.entry(campaignLevel);
+    std::string title = "Block Breaker - " + levelPack.name() + " " + std::to_string(campaignLevel + 1) + "/" +
+                        std::to_string(levelPack.levelCount()) + ": " +
+                        std::string(entry.name, strnlen(entry.name, LEVEL_NAME_SIZE));
+    gtk_window_set_title(GTK_WINDOW(window), title.c_str());
+}
+
+// Endless mode (--endless): rows keep scrolling in until they reach the paddle
+std::unique_ptr<EndlessField> endlessField;
+
+// Builds the level dealLevel() will deal next while this one is played, for
+// packs and level files; the standard level is small enough to deal on the
+// spot
+std::unique_ptr<LevelPrefetcher> prefetcher;
+
+// The campaign level dealt after this game: the next one unless it has been
+// lost. Always 0 for a level file.
+static size_t upcomingLevel() {
+    if (!levelPack.isOpen()) return 0;
+    if (game.isGameOver() && game.getLives() <= 0) return campaignLevel;
+    return (campaignLevel + 1) % levelPack.levelCount();
+}
+
+// Have the worker prepare the upcoming level, if it is not on the way yet
+static void prefetchUpcomingLevel() {
+    if (!prefetcher) return;
+    size_t index = upcomingLevel();
+    Quality quality = governor.quality();
+    prefetcher->request(static_cast<long>(index), [index, quality](PreparedLevel& prepared) {
+        LevelView level;
+        if (levelPack.isOpen()) {
+            levelPack.prefetch(index);
+            if (!levelPack.level(index, level)) return false;
         }
-        
+        prepareLevel(levelPack.isOpen() ? level : levelFile, prepared);
+        prepared.renderSprites(quality);
         return true;
-    }
-    
-    void draw(cairo_t* cr) {
-        // Draw background
-        cairo_set_source_rgb(cr, 0.1, 0.1, 0.2);  // Dark blue/black
-        cairo_paint(cr);
-        
-        // Draw blocks
-        for (auto& block : blocks) {
-            block.draw(cr);
+    });
+}
+
+// Deal the next level: a new endless field, the campaign's next (or same,
+// after a loss) level, the level file if one was given, else a fresh
+// standard level. Levels the prefetcher has ready start at once. After a
+// loss the game starts over with full lives and no score; a won level
+// carries both on to the next.
+static void dealLevel() {
+    bool lost = game.isGameOver() && game.getLives() <= 0;
+    if (endlessField) {
+        endlessField->reset();
+    } else if (levelPack.isOpen()) {
+        if (game.isGameOver() && game.getLives() > 0) {
+            campaignLevel = (campaignLevel + 1) % levelPack.levelCount();
         }
-        
-        // Draw paddle
-        paddle->draw(cr);
-        
-        // Draw ball
-        ball->draw(cr);
-        
-        // Draw score and lives
-        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-        cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-        cairo_set_font_size(cr, 20);
-        
-        char scoreText[50];
-        snprintf(scoreText, sizeof(scoreText), "Score: %d", score);
-        cairo_move_to(cr, 20, 30);
-        cairo_show_text(cr, scoreText);
-        
-        char livesText[50];
-        snprintf(livesText, sizeof(livesText), "Lives: %d", lives);
-        cairo_move_to(cr, WINDOW_WIDTH - 100, 30);
-        cairo_show_text(cr, livesText);
-        
-        // Draw game status message
-        if (!gameRunning && !gameOver) {
-            cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.7);
-            cairo_rectangle(cr, WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 30, 300, 60);
-            cairo_fill(cr);
-            
-            cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-            cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-            cairo_set_font_size(cr, 24);
-            cairo_move_to(cr, WINDOW_WIDTH / 2 - 140, WINDOW_HEIGHT / 2 + 10);
-            cairo_show_text(cr, "Click to Start!");
-        } else if (gameOver) {
-            cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.7);
-            cairo_rectangle(cr, WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 30, 300, 60);
-            cairo_fill(cr);
-            
-            cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-            cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-            cairo_set_font_size(cr, 24);
-            
-            if (lives <= 0) {
-                cairo_move_to(cr, WINDOW_WIDTH / 2 - 140, WINDOW_HEIGHT / 2 + 10);
-                cairo_show_text(cr, "Game Over!");
-            } else {
-                cairo_move_to(cr, WINDOW_WIDTH / 2 - 140, WINDOW_HEIGHT / 2 + 10);
-                cairo_show_text(cr, "You Win!");
-            }
-            
-            cairo_set_font_size(cr, 18);
-            cairo_move_to(cr, WINDOW_WIDTH / 2 - 120, WINDOW_HEIGHT / 2 + 40);
-            cairo_show_text(cr, "Click to Play Again");
+        if (lost) game.newGame();
+        LevelView level;
+        if (!levelPack.level(campaignLevel, level)) {
+            game.resetGame();
+        } else if (!prefetcher || !prefetcher->start(static_cast<long>(campaignLevel), game)) {
+            loadLevel(game, level);
         }
+        showCampaignLevel();
+    } else if (levelFile.isOpen()) {
+        if (lost) game.newGame();
+        if (!prefetcher || !prefetcher->start(0, game)) loadLevel(game, levelFile);
+    } else if (lost) {
+        game.newGame();
+    } else {
+        game.resetGame();
     }
-    
-    bool isGameRunning() const {
-        return gameRunning;
-    }
-    
-    bool isGameOver() const {
-        return gameOver;
-    }
-};
-
-// GTK application
-BlockBreakerGame game;
-GtkWidget* drawingArea;
+    prefetchUpcomingLevel();
+}
 
 // Drawing callback
 static gboolean on_draw(GtkWidget* widget, cairo_t* cr, gpointer user_data) {
-    game.draw(cr);
+    gint64 start = g_get_monotonic_time();
+    game.draw(cr, governor.quality());
+    governor.recordFrame(updateMs + (g_get_monotonic_time() - start) / 1000.0);
     return FALSE;
 }
 
 // Timer callback for game loop
 static gboolean on_timeout(gpointer user_data) {
+    if (autopilot) {
+        if (game.isGameOver() && ++gameOverTicks >= AI_RESTART_TICKS) {
+            dealLevel();
+            gameOverTicks = 0;
+        }
+        if (!game.isGameRunning() && !game.isGameOver()) {
+            game.start();
+        }
+        if (game.isGameRunning() && !game.isGameOver()) {
+            game.movePaddle(autopilot->decide(game, AI_BUDGET_MS));
+        }
+    }
+    
+    gint64 start = g_get_monotonic_time();
     game.update();
+    if (endlessField) endlessField->step();
+    statePublisher.publish(game, ++tickCount);
+    updateMs = (g_get_monotonic_time() - start) / 1000.0;
+    prefetchUpcomingLevel();
     gtk_widget_queue_draw(drawingArea);
     return G_SOURCE_CONTINUE;
 }
 
 // Mouse motion callback
 static gboolean on_motion_notify(GtkWidget* widget, GdkEventMotion* event, gpointer user_data) {
+    if (autopilot) return TRUE;
     game.movePaddle(event->x);
     gtk_widget_queue_draw(widget);
     return TRUE;
@@ -478,7 +168,7 @@ static gboolean on_motion_notify(GtkWidget* widget, GdkEventMotion* event, gpoin
 static gboolean on_button_press(GtkWidget* widget, GdkEventButton* event, gpointer user_data) {
     if (!game.isGameRunning()) {
         if (game.isGameOver()) {
-            game.resetGame();
+            dealLevel();
         }
         game.start();
         gtk_widget_queue_draw(widget);
@@ -486,16 +176,198 @@ static gboolean on_button_press(GtkWidget* widget, GdkEventButton* event, gpoint
     return TRUE;
 }
 
+// Offscreen draw benchmark: immediate vs batched block submission, with and
+// without the pixel-aligned rectangle fast path, and blitted block sprites,
+// for the standard grid and a 10k-block level; then 1000 balls drawn with
+// cairo vs from subpixel-phase sprites. Runs without a display.
+static int runDrawBenchmark() {
+    struct Case { const char* name; int rows, cols, frames; };
+    const Case cases[] = {
+        {"standard 5x9", BLOCK_ROWS, BLOCK_COLS, 2000},
+        {"large 100x100", 100, 100, 50},
+    };
+    struct Mode { const char* name; bool batched, fastRects, sprites; };
+    const Mode modes[] = {
+        {"immediate    ", false, false, false},
+        {"batched      ", true, false, false},
+        {"batched+fast ", true, true, false},
+        {"sprites      ", true, true, true},
+    };
+    
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, WINDOW_WIDTH, WINDOW_HEIGHT);
+    cairo_t* cr = cairo_create(surface);
+    std::cout << "blitter: " << blitter().name << std::endl;
+    
+    for (const Case& c : cases) {
+        for (Quality quality : {Quality::Full, Quality::Bevel}) {
+            for (const Mode& mode : modes) {
+                BlockBreakerGame bench;
+                bench.resetGame(c.rows, c.cols);
+                bench.setBatchedDrawing(mode.batched);
+                bench.setFastRects(mode.fastRects);
+                bench.setSpriteBlocks(mode.sprites);
+                bench.draw(cr, quality);  // Warm-up
+                
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < c.frames; i++) {
+                    bench.draw(cr, quality);
+                }
+                cairo_surface_flush(surface);
+                double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count() / c.frames;
+                
+                const DrawStats& stats = bench.drawStats();
+                std::cout << c.name << (quality == Quality::Full ? " full  " : " bevel ") << mode.name
+                          << " commands " << stats.commands
+                          << "  source changes " << stats.sourceChanges
+                          << "  fills/strokes " << stats.paints
+                          << "  pixel writes " << stats.pixelCommands
+                          << "  sprite blits " << stats.spriteBlits
+                          << "  " << ms << " ms/frame" << std::endl;
+            }
+        }
+    }
+    
+    // Balls: cairo gradient + arcs per ball vs subpixel-phase sprites
+    const int ballCount = 1000;
+    const int ballFrames = 20;
+    Ball model(0, 0, BALL_RADIUS);
+    PhaseSpriteCache phases;
+    phases.build(BALL_RADIUS + SPRITE_MARGIN, [&](cairo_t* spriteCr, double x, double y) {
+        model.x = x;
+        model.y = y;
+        model.draw(spriteCr, Quality::Full);
+    });
+    PixelTarget target;
+    target.acquire(cr);
+    
+    for (bool sprites : {false, true}) {
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < ballFrames; frame++) {
+            for (int i = 0; i < ballCount; i++) {
+                double x = 20 + (i * 7.37 + frame * 1.3) - 760 * std::floor((i * 7.37 + frame * 1.3) / 760);
+                double y = 20 + (i * 3.11) - 560 * std::floor(i * 3.11 / 560);
+                if (sprites) {
+                    phases.blit(target, x, y);
+                } else {
+                    model.x = x;
+                    model.y = y;
+                    model.draw(cr, Quality::Full);
+                }
+            }
+            cairo_surface_flush(surface);
+        }
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() / ballFrames;
+        std::cout << ballCount << " balls " << (sprites ? "phase sprites" : "cairo        ")
+                  << "  " << ms << " ms/frame" << std::endl;
+    }
+    cairo_surface_mark_dirty(surface);
+    
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+    return 0;
+}
+
+// Offscreen ball storm benchmark: 10,000 balls, physics and drawing timed
+// separately
+static int runStormBenchmark() {
+    const int frames = 300;
+    BlockBreakerGame storm;
+    storm.setBallStorm(9999, STORM_BALL_RADIUS);
+    storm.start();
+    
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, WINDOW_WIDTH, WINDOW_HEIGHT);
+    cairo_t* cr = cairo_create(surface);
+    double updateTotal = 0, drawTotal = 0;
+    size_t ballsAtEnd = 0;
+    for (int i = 0; i < frames; i++) {
+        auto start = std::chrono::steady_clock::now();
+        storm.update();
+        auto updated = std::chrono::steady_clock::now();
+        storm.draw(cr, Quality::Full);
+        cairo_surface_flush(surface);
+        auto drawn = std::chrono::steady_clock::now();
+        updateTotal += std::chrono::duration<double, std::milli>(updated - start).count();
+        drawTotal += std::chrono::duration<double, std::milli>(drawn - updated).count();
+        ballsAtEnd = storm.ballCount();
+    }
+    std::cout << "ball storm: update " << updateTotal / frames << " ms/frame, draw "
+              << drawTotal / frames << " ms/frame, " << ballsAtEnd << " balls left after "
+              << frames << " frames" << std::endl;
+    
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+    return 0;
+}
+
 int main(int argc, char** argv) {
-    // Initialize random number generator
-    srand(time(nullptr));
+    // Seed the game's random number generator and deal a fresh level
+    game.seed(time(nullptr));
+    game.resetGame();
+    
+    unsigned aiThreads = std::thread::hardware_concurrency();
+    bool attractMode = false;
+    for (int i = 1; i < argc; i++) {
+        SimdLevel level;
+        if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc && parseSimdLevel(argv[i + 1], level)) {
+            // Before any --bench-* option to affect it
+            if (!forceSimdLevel(level)) {
+                std::cerr << "This CPU does not support " << simdLevelName(level) << std::endl;
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--bench-draw") == 0) {
+            return runDrawBenchmark();
+        } else if (strcmp(argv[i], "--bench-storm") == 0) {
+            return runStormBenchmark();
+        } else if (strcmp(argv[i], "--ball-storm") == 0 && i + 1 < argc) {
+            game.setBallStorm(std::max(0, atoi(argv[++i]) - 1), STORM_BALL_RADIUS);
+        } else if (strcmp(argv[i], "--ai") == 0) {
+            attractMode = true;
+        } else if (strcmp(argv[i], "--ai-threads") == 0 && i + 1 < argc) {
+            aiThreads = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (!statePublisher.open(name)) {
+                std::cerr << "Could not create shared memory segment " << name << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            const char* path = argv[++i];
+            if (!levelFile.open(path)) {
+                std::cerr << "Could not load level " << path << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+            const char* path = argv[++i];
+            if (!levelPack.open(path) || levelPack.levelCount() == 0) {
+                std::cerr << "Could not load level pack " << path << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--endless") == 0) {
+            endlessField = std::make_unique<EndlessField>(game, time(nullptr));
+            endlessField->reset();
+        } else if (strcmp(argv[i], "--pack-start") == 0 && i + 1 < argc) {
+            campaignLevel = static_cast<size_t>(std::max(1, atoi(argv[++i])) - 1);
+        }
+    }
+    if (!endlessField && (levelPack.isOpen() || levelFile.isOpen())) {
+        prefetcher = std::make_unique<LevelPrefetcher>();
+        if (levelPack.isOpen()) campaignLevel = std::min(campaignLevel, levelPack.levelCount() - 1);
+        dealLevel();
+    }
+    if (attractMode) {
+        autopilot = std::make_unique<MctsPlayer>(aiThreads);
+    }
     
     // Initialize GTK
     gtk_init(&argc, &argv);
     
     // Create window
-    GtkWidget* window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(window), "Block Breaker");
+    if (levelPack.isOpen()) showCampaignLevel();
     gtk_window_set_default_size(GTK_WINDOW(window), WINDOW_WIDTH, WINDOW_HEIGHT);
     gtk_window_set_position(GTK_WINDOW(window), GTK_WIN_POS_CENTER);
     g_signal_connect(window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
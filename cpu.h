@@ -0,0 +1,84 @@
+// BlockBreaker - runtime selection of SIMD kernels
+//
+// One binary carries every kernel variant, each compiled for its own
+// instruction set with target attributes, and picks among them at run time
+// from CPUID. simdLevel() is the level kernels dispatch on: the best the
+// CPU supports, or a lower one forced with forceSimdLevel() (the --simd
+// command line switch) or the BLOCKBREAKER_SIMD environment variable, for
+// testing the fallbacks on new hardware.
+
+#ifndef BLOCKBREAKER_CPU_H
+#define BLOCKBREAKER_CPU_H
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLOCKBREAKER_X86 1
+#endif
+
+// Ordered, so a kernel for level L runs wherever simdLevel() >= L
+enum class SimdLevel {
+    Scalar,
+    Sse2,
+    Avx2,
+    Avx512      // AVX-512 F and BW
+};
+
+inline const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Sse2: return "sse2";
+        case SimdLevel::Avx2: return "avx2";
+        case SimdLevel::Avx512: return "avx512";
+    }
+    return "?";
+}
+
+inline bool parseSimdLevel(const std::string& name, SimdLevel& level) {
+    for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2, SimdLevel::Avx512}) {
+        if (name == simdLevelName(l)) {
+            level = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The best level this CPU and OS support, from CPUID
+inline SimdLevel detectSimdLevel() {
+#ifdef BLOCKBREAKER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdLevel::Avx512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::Sse2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+inline std::atomic<int>& simdLevelSetting() {
+    static std::atomic<int> setting([] {
+        SimdLevel level = detectSimdLevel();
+        SimdLevel requested;
+        const char* env = std::getenv("BLOCKBREAKER_SIMD");
+        if (env && parseSimdLevel(env, requested) && requested < level) level = requested;
+        return static_cast<int>(level);
+    }());
+    return setting;
+}
+
+inline SimdLevel simdLevel() {
+    return static_cast<SimdLevel>(simdLevelSetting().load(std::memory_order_relaxed));
+}
+
+// Run kernels at the given level from now on. Fails, changing nothing, if
+// the CPU does not support it.
+inline bool forceSimdLevel(SimdLevel level) {
+    if (level > detectSimdLevel()) return false;
+    simdLevelSetting().store(static_cast<int>(level), std::memory_order_relaxed);
+    return true;
+}
+
+#endif // BLOCKBREAKER_CPU_H
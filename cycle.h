@@ -0,0 +1,202 @@
+// BlockBreaker - stuck-trajectory detection for headless runs
+//
+// Random jitter only enters a game when a block breaks, so once the ball
+// stops reaching blocks a deterministic paddle controller can hold it in a
+// bounce loop that repeats until the tick limit. CycleDetector hashes the
+// state each time the first ball turns vertically (paddle, ceiling or block)
+// and keeps a ring of the latest hashes since the last score or life change;
+// a repeat means the game has come back to a state it already left.
+// Positions and velocities are hashed on a fine grid rather than bit for bit,
+// since a loop's doubles can drift by an ulp per pass.
+//
+// The event-driven simulation reports every collision at its exact moment
+// of contact, so there the detector keys on collisions instead
+// (observeCollision()): each one is a point of the ring, hashed with the
+// kind of impact. Exact impacts repeat a state far more readily than ticks
+// do, and a paddle that reacts to something else than the state (a random
+// lane, say) can take the ball elsewhere from the same state, so one repeat
+// is not enough there: the collisions since it must repeat a whole period
+// more, and at least CYCLE_CONFIRM of them, before the game counts as
+// looping.
+
+#ifndef BLOCKBREAKER_CYCLE_H
+#define BLOCKBREAKER_CYCLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "game.h"
+#include "eventsim.h"
+
+const int CYCLE_RING = 64;                 // Turning points remembered
+const double CYCLE_POSITION_STEP = 0.125;  // Hash grid, pixels
+const double CYCLE_VELOCITY_STEP = 1.0 / 4096;
+const int CYCLE_CONFIRM = 16;              // Collisions a repeat must hold for (observeCollision())
+
+// What a run does with a game found looping
+enum class StuckAction {
+    Ignore,
+    End,        // Stop the game where it is; it counts as not won
+    Perturb     // BlockBreakerGame::perturb() and play on
+};
+
+inline const char* stuckActionName(StuckAction action) {
+    switch (action) {
+        case StuckAction::Ignore: return "off";
+        case StuckAction::End: return "end";
+        case StuckAction::Perturb: return "perturb";
+    }
+    return "?";
+}
+
+inline bool parseStuckAction(const std::string& name, StuckAction& action) {
+    for (StuckAction a : {StuckAction::Ignore, StuckAction::End, StuckAction::Perturb}) {
+        if (name == stuckActionName(a)) {
+            action = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+class CycleDetector {
+private:
+    uint64_t ring[CYCLE_RING];
+    int filled = 0, head = 0;
+    bool falling = false;       // First ball's vertical direction last time
+    int score = -1, lives = -1;
+    uint64_t loops = 0;
+    int lastPeriod = 0;
+    int candidate = 0;          // Period of a repeat being confirmed, or 0
+    int matched = 0;            // Points of it repeated so far
+
+    static uint64_t mix(uint64_t hash, int64_t value) {
+        hash ^= static_cast<uint64_t>(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+
+    static int64_t quantize(double value, double step) {
+        return static_cast<int64_t>(std::llround(value / step));
+    }
+
+    // Start over when a block breaks or a life is lost: the game has moved on
+    void follow(const BlockBreakerGame& game) {
+        if (game.getScore() != score || game.getLives() != lives) {
+            score = game.getScore();
+            lives = game.getLives();
+            clear();
+        }
+    }
+
+    bool found(int period) {
+        lastPeriod = period;
+        loops++;
+        clear();
+        return true;
+    }
+
+    void push(uint64_t h) {
+        ring[head] = h;
+        head = (head + 1) % CYCLE_RING;
+        if (filled < CYCLE_RING) filled++;
+    }
+
+    // Add a turning point or collision to the ring, or report the loop it
+    // closes: at the first repeat, or with confirm once a whole period, and
+    // CYCLE_CONFIRM points at least, have repeated after it
+    bool record(uint64_t h, bool confirm) {
+        if (candidate) {
+            if (ring[(head - candidate + CYCLE_RING) % CYCLE_RING] == h) {
+                if (++matched >= std::max(candidate, CYCLE_CONFIRM)) return found(candidate);
+                push(h);
+                return false;
+            }
+            candidate = 0;  // The game went elsewhere this time
+        }
+        for (int i = 0; i < filled; i++) {
+            if (ring[i] == h) {
+                int period = (head - i + CYCLE_RING) % CYCLE_RING;
+                if (period == 0) period = CYCLE_RING;
+                if (!confirm) return found(period);
+                candidate = period;
+                matched = 0;
+                break;
+            }
+        }
+        push(h);
+        return false;
+    }
+
+    static uint64_t hash(const BlockBreakerGame& game) {
+        uint64_t h = mix(0, quantize(game.getPaddle().x, CYCLE_POSITION_STEP));
+        h = mix(h, static_cast<int64_t>(game.getBalls().size()));
+        for (const Ball& ball : game.getBalls()) {
+            h = mix(h, quantize(ball.x, CYCLE_POSITION_STEP));
+            h = mix(h, quantize(ball.y, CYCLE_POSITION_STEP));
+            h = mix(h, quantize(ball.dx, CYCLE_VELOCITY_STEP));
+            h = mix(h, quantize(ball.dy, CYCLE_VELOCITY_STEP));
+        }
+        return h;
+    }
+
+public:
+    void clear() {
+        filled = head = 0;
+        candidate = 0;
+    }
+
+    // Look at the game after a tick. True when it has entered a loop; the
+    // ring is then cleared, so a loop that persists is reported again only
+    // after it has repeated once more.
+    bool observe(const BlockBreakerGame& game) {
+        follow(game);
+        if (game.getBalls().empty()) return false;
+        bool nowFalling = game.getBalls().front().dy > 0;
+        if (nowFalling == falling) return false;
+        falling = nowFalling;
+        return record(hash(game), false);
+    }
+
+    // Look at the game after an EventSimulation event, as observe() does
+    // after a tick. Paddle moves are not collisions and are skipped.
+    bool observeCollision(const BlockBreakerGame& game, SimEvent kind) {
+        follow(game);
+        if (kind == SimEvent::None || kind == SimEvent::PaddleMove || game.getBalls().empty()) return false;
+        return record(mix(hash(game), static_cast<int64_t>(kind)), true);
+    }
+
+    // Loops found since construction
+    uint64_t detections() const {
+        return loops;
+    }
+
+    // Turning points (collisions, for observeCollision()) per pass of the
+    // last loop found
+    int period() const {
+        return lastPeriod;
+    }
+};
+
+// Carry out the action for a game found looping. Returns false when the
+// game should stop here.
+inline bool actOnStuck(BlockBreakerGame& game, StuckAction action) {
+    if (action == StuckAction::Perturb) game.perturb();
+    return action != StuckAction::End;
+}
+
+// Run the detector after a tick and carry out the action. Returns false
+// when the game should stop here.
+inline bool checkStuck(CycleDetector& detector, BlockBreakerGame& game, StuckAction action) {
+    if (action == StuckAction::Ignore || !detector.observe(game)) return true;
+    return actOnStuck(game, action);
+}
+
+// The same after an EventSimulation event
+inline bool checkStuck(CycleDetector& detector, BlockBreakerGame& game, SimEvent kind, StuckAction action) {
+    if (action == StuckAction::Ignore || !detector.observeCollision(game, kind)) return true;
+    return actOnStuck(game, action);
+}
+
+#endif // BLOCKBREAKER_CYCLE_H
@@ -0,0 +1,165 @@
+// BlockBreaker - endless mode
+//
+// EndlessField turns a game into an endless one: the block field creeps
+// down the screen and new rows, generated from the seed and the row number
+// alone, scroll in from above. Blocks live in a fixed pool of chunks of
+// ENDLESS_CHUNK_ROWS rows, each a fixed slice of the game's blocks, stacked
+// from above the top of the screen to its bottom. A chunk that scrolls off
+// the bottom is regenerated in place as the next rows above the topmost
+// one, so the block count, the broadphase and the sprite cache never grow,
+// and a tick costs the same after hours of play as after a minute.
+//
+// The field moves in whole pixels, which keeps cached block sprites usable.
+// The broadphase moves along with it and is only rebuilt, over the fixed
+// pool, when a chunk is dealt again. The game ends when a block still
+// standing reaches the paddle.
+
+#ifndef BLOCKBREAKER_ENDLESS_H
+#define BLOCKBREAKER_ENDLESS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "game.h"
+
+const int ENDLESS_CHUNK_ROWS = 4;
+const double ENDLESS_SCROLL_SPEED = 0.05;   // Pixels per tick
+const int ENDLESS_FILL_PERCENT = 70;        // Chance that a cell holds a block
+
+class EndlessField {
+private:
+    static const int COLS = BLOCK_COLS;
+    static const int PITCH_X = BLOCK_WIDTH + BLOCK_SPACING;
+    static const int PITCH_Y = BLOCK_HEIGHT + BLOCK_SPACING;
+    static const int CHUNK_BLOCKS = ENDLESS_CHUNK_ROWS * COLS;
+    static const int CHUNK_HEIGHT = ENDLESS_CHUNK_ROWS * PITCH_Y;
+    // Enough chunks to reach from above the top edge past the bottom one
+    static const int CHUNKS = (WINDOW_HEIGHT + CHUNK_HEIGHT - 1) / CHUNK_HEIGHT + 2;
+
+    BlockBreakerGame& game;
+    uint64_t seed;
+    double speed;
+    int chunkTop[CHUNKS];       // Screen y of each chunk's first row
+    int topChunk = 0;           // The chunk highest up the screen
+    uint64_t nextRow = 0;       // Number of the next row to generate
+    double pending = 0;         // Scroll not yet applied, under a pixel
+    uint64_t recycled = 0;
+
+    // Deal a chunk's rows, the lowest first, from the row numbers alone
+    void generate(int chunk) {
+        for (int row = ENDLESS_CHUNK_ROWS - 1; row >= 0; row--) {
+            uint64_t state = seed + 0x9e3779b97f4a7c15ull * ++nextRow;  // SplitMix64 of the row
+            state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9ull;
+            state = (state ^ (state >> 27)) * 0x94d049bb133111ebull;
+            Rng rowRng(state ^ (state >> 31));
+            for (int col = 0; col < COLS; col++) {
+                size_t index = static_cast<size_t>(chunk) * CHUNK_BLOCKS + row * COLS + col;
+                Block& block = game.blocks[index];
+                if (block.active) game.roster.remove(static_cast<uint32_t>(index));
+                block = Block(SIDE_MARGIN + col * PITCH_X, chunkTop[chunk] + row * PITCH_Y,
+                              BLOCK_WIDTH, BLOCK_HEIGHT, rowRng);
+                block.active = rowRng.below(100) < ENDLESS_FILL_PERCENT;
+                if (block.active) game.roster.add(static_cast<uint32_t>(index));
+#ifndef BLOCKBREAKER_HEADLESS
+                if (index < game.blockSprites.size()) game.blockSprites[index] = Sprite();
+#endif
+            }
+        }
+    }
+
+    void moveChunk(int chunk, int dy) {
+        chunkTop[chunk] += dy;
+        Block* block = &game.blocks[static_cast<size_t>(chunk) * CHUNK_BLOCKS];
+        for (int i = 0; i < CHUNK_BLOCKS; i++) block[i].y += dy;
+    }
+
+    // A block still standing at or below the paddle's top
+    bool reachedPaddle() const {
+        double line = game.paddle.y - game.paddle.height / 2.0;
+        for (int chunk = 0; chunk < CHUNKS; chunk++) {
+            if (chunkTop[chunk] + CHUNK_HEIGHT <= line) continue;
+            const Block* block = &game.blocks[static_cast<size_t>(chunk) * CHUNK_BLOCKS];
+            for (int i = 0; i < CHUNK_BLOCKS; i++) {
+                if (block[i].active && block[i].y + block[i].height > line) return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    EndlessField(BlockBreakerGame& endlessGame, uint64_t fieldSeed, double scrollSpeed = ENDLESS_SCROLL_SPEED)
+        : game(endlessGame), seed(fieldSeed), speed(scrollSpeed) {}
+
+    // Start a new endless game: full lives, no score, and the pool dealt with
+    // its lowest chunk ending where the standard level does
+    void reset() {
+        game.newGame();
+        Block empty(0, 0, 0, 0, 0, 0, 0);
+        empty.active = false;
+        game.blocks.assign(static_cast<size_t>(CHUNKS) * CHUNK_BLOCKS, empty);
+        game.roster.build(game.blocks);
+        game.levelCount++;
+#ifndef BLOCKBREAKER_HEADLESS
+        game.blockSprites.clear();
+#endif
+        game.serve();
+        game.endless = true;
+        nextRow = 0;
+        pending = 0;
+        recycled = 0;
+        for (int chunk = 0; chunk < CHUNKS; chunk++) {
+            chunkTop[chunk] = TOP_MARGIN + MAX_FIELD_HEIGHT - (chunk + 1) * CHUNK_HEIGHT;
+            generate(chunk);
+        }
+        topChunk = CHUNKS - 1;
+        game.blockGrid.build(game.blocks, SIDE_MARGIN, chunkTop[topChunk], PITCH_X, PITCH_Y);
+    }
+
+    // Scroll after a game tick while the ball is in play. Ends the game
+    // when the blocks reach the paddle.
+    void step() {
+        if (!game.gameRunning || game.gameOver) return;
+        pending += speed;
+        int dy = static_cast<int>(pending);
+        if (dy == 0) return;
+        pending -= dy;
+
+        for (int chunk = 0; chunk < CHUNKS; chunk++) moveChunk(chunk, dy);
+        // Chunks below the screen are empty, or the game would have ended
+        bool dealt = false;
+        for (int chunk = 0; chunk < CHUNKS; chunk++) {
+            if (chunkTop[chunk] < WINDOW_HEIGHT) continue;
+            chunkTop[chunk] = chunkTop[topChunk] - CHUNK_HEIGHT;
+            topChunk = chunk;
+            generate(chunk);
+            recycled++;
+            dealt = true;
+        }
+        if (dealt) {
+            game.blockGrid.build(game.blocks, SIDE_MARGIN, chunkTop[topChunk], PITCH_X, PITCH_Y);
+        } else {
+            game.blockGrid.shiftY(dy);
+        }
+
+        if (reachedPaddle()) {
+            game.lives = 0;
+            game.gameOver = true;
+        }
+    }
+
+    // Rows generated since reset(), counting those still to scroll in
+    uint64_t rows() const {
+        return nextRow;
+    }
+
+    uint64_t chunksRecycled() const {
+        return recycled;
+    }
+
+    // Blocks in the pool, standing or not; constant
+    static size_t poolBlocks() {
+        return static_cast<size_t>(CHUNKS) * CHUNK_BLOCKS;
+    }
+};
+
+#endif // BLOCKBREAKER_ENDLESS_H
@@ -0,0 +1,172 @@
+// BlockBreaker - batched environment library for external trainers
+//
+// Implements the C API in env.h over the headless game core. Build with:
+// g++ -std=c++17 -O2 -pthread -fPIC -shared -DBLOCKBREAKER_HEADLESS -o libblockbreaker_env.so env.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "env.h"
+#include "game.h"
+#include "cycle.h"
+#include "pixelobs.h"
+#include "threadpool.h"
+
+// Environments per thread pool job, enough to make handing them out cheap
+const int ENV_CHUNK = 256;
+const int OBSERVATION_HEADER = 6;
+
+struct bb_env {
+    std::vector<BlockBreakerGame> games;
+    std::vector<uint32_t> episodes;     // Episodes started, per environment
+    std::vector<long> ticks;            // Ticks into the current episode
+    std::vector<CycleDetector> loops;   // Ends episodes stuck in a bounce loop
+    uint64_t seed;
+    int observationSize;
+    PixelObserver grayView, rgbView;
+    mutable ThreadPool pool;   // Runs jobs for const calls too
+
+    bb_env(int count, uint64_t baseSeed, unsigned threads)
+        : episodes(count, 0), ticks(count, 0), loops(count), seed(baseSeed),
+          grayView(BB_ENV_PIXELS, 1), rgbView(BB_ENV_PIXELS, 3), pool(threads) {
+        games.reserve(count);
+        for (int i = 0; i < count; i++) {
+            games.emplace_back();
+        }
+        observationSize = OBSERVATION_HEADER + static_cast<int>(games.front().getBlocks().size());
+    }
+
+    // Call fn(index) for every environment, chunked across the pool.
+    // Returns false if a call threw; an exception must not leave a pool
+    // worker, where it would end the process.
+    template <typename Fn>
+    bool forEach(Fn fn) const {
+        size_t count = games.size();
+        std::atomic<bool> failed(false);
+        pool.run((count + ENV_CHUNK - 1) / ENV_CHUNK, [&](size_t chunk) {
+            size_t end = std::min(count, (chunk + 1) * ENV_CHUNK);
+            try {
+                for (size_t i = chunk * ENV_CHUNK; i < end; i++) fn(i);
+            } catch (...) {
+                failed = true;
+            }
+        });
+        return !failed;
+    }
+
+    void startEpisode(size_t i) {
+        // Distinct, reproducible seed per environment and episode
+        uint64_t episodeSeed = seed ^ (i * 0x9e3779b97f4a7c15ull) ^ (episodes[i] * 0xbf58476d1ce4e5b9ull);
+        episodes[i]++;
+        ticks[i] = 0;
+        loops[i].clear();
+        games[i].seed(episodeSeed);
+        games[i].newGame();
+        games[i].start();
+    }
+
+    void observe(size_t i, float* out) const {
+        const BlockBreakerGame& game = games[i];
+        const Ball& ball = game.getBalls().front();
+        out[0] = static_cast<float>(ball.x / WINDOW_WIDTH);
+        out[1] = static_cast<float>(ball.y / WINDOW_HEIGHT);
+        out[2] = static_cast<float>(ball.dx / BALL_SPEED);
+        out[3] = static_cast<float>(ball.dy / BALL_SPEED);
+        out[4] = static_cast<float>(game.getPaddle().x / WINDOW_WIDTH);
+        out[5] = static_cast<float>(game.getLives()) / START_LIVES;
+        const std::vector<Block>& blocks = game.getBlocks();
+        for (size_t b = 0; b < blocks.size(); b++) {
+            out[OBSERVATION_HEADER + b] = blocks[b].active ? 1.0f : 0.0f;
+        }
+    }
+};
+
+extern "C" {
+
+bb_env* bb_env_create(int count, uint64_t seed, int threads) {
+    if (count <= 0) return nullptr;
+    unsigned poolThreads = threads > 0 ? static_cast<unsigned>(threads) : std::thread::hardware_concurrency();
+    try {
+        bb_env* env = new bb_env(count, seed, std::max(1u, poolThreads));
+        if (!env->forEach([&](size_t i) { env->startEpisode(i); })) {
+            delete env;
+            return nullptr;
+        }
+        return env;
+    } catch (...) {
+        return nullptr;  // Nothing may propagate across the C boundary
+    }
+}
+
+void bb_env_destroy(bb_env* env) {
+    delete env;
+}
+
+int bb_env_count(const bb_env* env) {
+    return static_cast<int>(env->games.size());
+}
+
+int bb_env_observation_size(const bb_env* env) {
+    return env->observationSize;
+}
+
+int bb_env_reset(bb_env* env, const uint8_t* mask, float* observations) {
+    try {
+        bool reset = env->forEach([&](size_t i) {
+            if (!mask || mask[i]) env->startEpisode(i);
+            env->observe(i, observations + i * env->observationSize);
+        });
+        return reset ? 0 : -1;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int bb_env_step(bb_env* env, const float* actions, float* observations, float* rewards, uint8_t* dones) {
+    try {
+        bool stepped = env->forEach([&](size_t i) {
+            BlockBreakerGame& game = env->games[i];
+            int score = game.getScore();
+            int lives = game.getLives();
+
+            game.movePaddle(actions[i] * WINDOW_WIDTH);
+            game.update();
+            if (!game.isGameRunning() && !game.isGameOver()) {
+                game.start();  // Serve again straight away after a lost life
+            }
+            env->ticks[i]++;
+
+            rewards[i] = static_cast<float>((game.getScore() - score) / 10 - (lives - game.getLives()));
+            bool stuck = env->loops[i].observe(game);
+            bool done = game.isGameOver() || stuck || env->ticks[i] >= BB_ENV_MAX_EPISODE_TICKS;
+            dones[i] = done;
+            if (done) env->startEpisode(i);
+            env->observe(i, observations + i * env->observationSize);
+        });
+        return stepped ? 0 : -1;
+    } catch (...) {
+        return -1;
+    }
+}
+
+uint64_t bb_env_stuck_episodes(const bb_env* env) {
+    uint64_t total = 0;
+    for (const CycleDetector& detector : env->loops) total += detector.detections();
+    return total;
+}
+
+int bb_env_render(const bb_env* env, uint8_t* pixels, int channels) {
+    const PixelObserver& view = channels == 3 ? env->rgbView : env->grayView;
+    try {
+        bool rendered = env->forEach([&](size_t i) {
+            view.render(env->games[i], pixels + i * view.bytes());
+        });
+        return rendered ? 0 : -1;
+    } catch (...) {
+        return -1;
+    }
+}
+
+}
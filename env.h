@@ -0,0 +1,72 @@
+/* BlockBreaker - batched environment C API for external trainers
+ *
+ * libblockbreaker_env.so runs a batch of headless games behind a plain C
+ * interface, so it can be loaded through any FFI. Every call works on the
+ * whole batch, and results are written straight into buffers the caller owns:
+ *
+ *   observations  count * bb_env_observation_size() floats
+ *   actions       count floats, the paddle target x as a fraction of the
+ *                 window width (0 = left edge, 1 = right edge)
+ *   rewards       count floats: blocks broken this step, minus one per life lost
+ *   dones         count bytes, 1 where an episode ended this step
+ *
+ * An observation is the first ball's x, y, dx and dy, the paddle x and the
+ * lives left, each scaled to about [-1, 1], followed by one 0/1 flag per block.
+ *
+ * bb_env_render() adds a pixel view for every environment: BB_ENV_PIXELS square,
+ * 1 (grayscale) or 3 (RGB) bytes per pixel, rows top to bottom, environments
+ * back to back.
+ *
+ * A finished episode (game over, BB_ENV_MAX_EPISODE_TICKS reached, or the ball
+ * caught in a bounce loop that never reaches a block) resets in place during
+ * the step that ends it: its done flag and final reward are reported, and its
+ * observation is already the first one of the next episode.
+ *
+ * The batched calls return 0, or -1 if they failed (e.g. out of memory).
+ * After a failure the output buffers and the games are in no defined state;
+ * destroy the batch.
+ * Episodes are seeded from the create() seed, the environment index and the
+ * episode number, so a batch replays exactly for the same actions whatever
+ * the thread count.
+ */
+
+#ifndef BLOCKBREAKER_ENV_H
+#define BLOCKBREAKER_ENV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BB_ENV_MAX_EPISODE_TICKS 20000
+#define BB_ENV_PIXELS 84
+
+typedef struct bb_env bb_env;
+
+/* Create count games; threads <= 0 uses every core. NULL on failure. */
+bb_env* bb_env_create(int count, uint64_t seed, int threads);
+void bb_env_destroy(bb_env* env);
+
+int bb_env_count(const bb_env* env);
+int bb_env_observation_size(const bb_env* env);
+
+/* Start new episodes where mask[i] is nonzero, or everywhere if mask is NULL,
+ * and write every environment's observation. */
+int bb_env_reset(bb_env* env, const uint8_t* mask, float* observations);
+
+/* Advance every game one tick. */
+int bb_env_step(bb_env* env, const float* actions, float* observations, float* rewards, uint8_t* dones);
+
+/* Episodes ended early so far because the ball was stuck in a loop. */
+uint64_t bb_env_stuck_episodes(const bb_env* env);
+
+/* Rasterize every environment into count * BB_ENV_PIXELS^2 * channels bytes;
+ * channels is 1 or 3. */
+int bb_env_render(const bb_env* env, uint8_t* pixels, int channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOCKBREAKER_ENV_H */
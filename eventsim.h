@@ -0,0 +1,185 @@
+// BlockBreaker - event-driven simulation for headless runs
+//
+// Between collisions the ball travels in a straight line, so instead of
+// stepping update() one tick at a time this engine computes the next time of
+// impact analytically and jumps straight to it. Time is measured in ticks
+// (one update() step), and velocities keep their per-tick units.
+//
+// Collisions follow the stepped game's rules: the same paddle reflection,
+// side selection, random jitter and speed normalization on block hits, and
+// the same scoring, lives and win condition. Impacts are found at the exact
+// moment of contact rather than after a tick of overlap, so trajectories
+// drift from update() over time; only the first ball is simulated.
+
+#ifndef BLOCKBREAKER_EVENTSIM_H
+#define BLOCKBREAKER_EVENTSIM_H
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "game.h"
+
+enum class SimEvent {
+    None,
+    Wall,
+    Ceiling,
+    Paddle,
+    Block,
+    BallLost,
+    PaddleMove
+};
+
+class EventSimulation {
+private:
+    struct PaddleInput {
+        double time;
+        double x;
+        bool operator>(const PaddleInput& other) const {
+            return time > other.time;
+        }
+    };
+
+    BlockBreakerGame& game;
+    double now;
+    uint64_t eventCount;
+    bool stopped;
+    std::priority_queue<PaddleInput, std::vector<PaddleInput>, std::greater<PaddleInput>> inputs;
+
+    void advanceBall(Ball& ball, double dt) {
+        ball.x += ball.dx * dt;
+        ball.y += ball.dy * dt;
+    }
+
+    void serve() {
+        Ball& ball = game.balls.front();
+        ball = Ball(game.paddle.x, WINDOW_HEIGHT - 50, ball.radius);
+        game.gameRunning = true;
+    }
+
+public:
+    explicit EventSimulation(BlockBreakerGame& g) : game(g), now(0), eventCount(0), stopped(false) {
+        if (!game.gameOver) game.gameRunning = true;
+    }
+
+    // Move the paddle to x at the given time
+    void schedulePaddle(double time, double x) {
+        inputs.push({time, x});
+    }
+
+    double time() const {
+        return now;
+    }
+
+    uint64_t events() const {
+        return eventCount;
+    }
+
+    // Make runUntil() return after the current event
+    void stop() {
+        stopped = true;
+    }
+
+    // Process the next event no later than until and return its kind, or
+    // advance to until and return None. Balls are served again immediately
+    // after a lost life.
+    SimEvent step(double until) {
+        if (game.gameOver || now >= until) return SimEvent::None;
+        Ball& ball = game.balls.front();
+        const Paddle& paddle = game.paddle;
+        double r = ball.radius;
+        double limit = until - now;
+
+        // Walls, ceiling, paddle line and floor
+        SimEvent kind = SimEvent::None;
+        double dt = limit;
+        auto consider = [&](double t, SimEvent event) {
+            if (t >= 0 && t < dt) {
+                dt = t;
+                kind = event;
+            }
+        };
+        // (A ball already at or past a wall bounces at once.)
+        if (ball.dx < 0) consider(std::max(0.0, (r - ball.x) / ball.dx), SimEvent::Wall);
+        if (ball.dx > 0) consider(std::max(0.0, (WINDOW_WIDTH - r - ball.x) / ball.dx), SimEvent::Wall);
+        if (ball.dy < 0) consider(std::max(0.0, (r - ball.y) / ball.dy), SimEvent::Ceiling);
+        double paddleTop = paddle.y - paddle.height / 2;
+        if (ball.dy > 0) {
+            if (ball.y + r <= paddleTop) consider((paddleTop - r - ball.y) / ball.dy, SimEvent::Paddle);
+            consider((WINDOW_HEIGHT + r - ball.y) / ball.dy, SimEvent::BallLost);
+        }
+        if (!inputs.empty() && inputs.top().time - now < dt) {
+            dt = std::max(0.0, inputs.top().time - now);
+            kind = SimEvent::PaddleMove;
+        }
+
+        double blockTime;
+        size_t block = game.firstBlockOnPath(ball, dt, blockTime);
+        if (block != game.blocks.size() && blockTime <= dt) {
+            dt = blockTime;
+            kind = SimEvent::Block;
+        }
+
+        advanceBall(ball, dt);
+        now += dt;
+        if (kind == SimEvent::None) return kind;
+        eventCount++;
+
+        switch (kind) {
+            case SimEvent::Wall:
+                ball.dx = -ball.dx;
+                break;
+            case SimEvent::Ceiling:
+                ball.dy = std::abs(ball.dy);
+                break;
+            case SimEvent::Paddle:
+                if (ball.x >= paddle.x - paddle.width / 2 && ball.x <= paddle.x + paddle.width / 2) {
+                    game.bounceOffPaddle(ball);
+                } else {
+                    ball.y += 1e-9;  // Missed: move past the paddle line
+                }
+                break;
+            case SimEvent::Block: {
+                const Block& target = game.blocks[block];
+                double closestX = std::max(target.x, std::min(ball.x, target.x + target.width));
+                double closestY = std::max(target.y, std::min(ball.y, target.y + target.height));
+                game.hitBlock(ball, block, BlockBreakerGame::impactSide(target, closestX, closestY));
+                if (game.roster.live.empty()) {
+                    game.gameOver = true;  // Player wins
+                }
+                break;
+            }
+            case SimEvent::BallLost:
+                game.lives--;
+                if (game.lives <= 0) {
+                    game.gameOver = true;
+                } else {
+                    serve();
+                }
+                break;
+            case SimEvent::PaddleMove: {
+                double x = inputs.top().x;
+                inputs.pop();
+                game.paddle.move(x);
+                break;
+            }
+            case SimEvent::None:
+                break;
+        }
+        return kind;
+    }
+
+    // Run until the given time, game over or stop(), calling onEvent after
+    // every event so a controller can schedule paddle moves in response
+    void runUntil(double until, const std::function<void(SimEvent)>& onEvent = nullptr) {
+        stopped = false;
+        while (!game.gameOver && now < until && !stopped) {
+            SimEvent kind = step(until);
+            if (onEvent && kind != SimEvent::None) onEvent(kind);
+        }
+    }
+};
+
+#endif // BLOCKBREAKER_EVENTSIM_H
@@ -0,0 +1,124 @@
+// BlockBreaker - fixed-point arithmetic for bit-exact physics
+//
+// With BLOCKBREAKER_FIXED_POINT defined, the stepped physics does its
+// arithmetic in 48.16 fixed point: integer adds, multiplies, divides, an
+// integer square root and a sine table generated at compile time with
+// integer math. Nothing goes through libm or floating-point rounding, so a
+// game follows the same trajectory on every compiler, optimization level
+// and CPU, and recorded inputs replay exactly.
+//
+// Game state stays in doubles. Every value the physics stores is a multiple
+// of 2^-16 well inside the 53-bit mantissa, so converting in and out is
+// exact and the rest of the code reads it unchanged.
+
+#ifndef BLOCKBREAKER_FIXED_H
+#define BLOCKBREAKER_FIXED_H
+
+#include <cmath>
+#include <cstdint>
+
+const int FIXED_FRACTION_BITS = 16;
+const int64_t FIXED_ONE = int64_t(1) << FIXED_FRACTION_BITS;
+const int32_t FIXED_TURN = 1 << 16;    // Binary angle units in a full turn
+
+struct Fixed {
+    int64_t raw;
+
+    static constexpr Fixed fromRaw(int64_t value) {
+        return Fixed{value};
+    }
+
+    static constexpr Fixed fromInt(int64_t value) {
+        return Fixed{value * FIXED_ONE};
+    }
+
+    // numerator / denominator, rounded toward zero
+    static constexpr Fixed ratio(int64_t numerator, int64_t denominator) {
+        return Fixed{numerator * FIXED_ONE / denominator};
+    }
+
+    // Nearest fixed value; scaling by a power of two and llround() are exact
+    static Fixed fromDouble(double value) {
+        return Fixed{std::llround(value * FIXED_ONE)};
+    }
+
+    double toDouble() const {
+        return static_cast<double>(raw) / FIXED_ONE;
+    }
+
+    Fixed operator-() const { return Fixed{-raw}; }
+    Fixed operator+(Fixed other) const { return Fixed{raw + other.raw}; }
+    Fixed operator-(Fixed other) const { return Fixed{raw - other.raw}; }
+    // Arithmetic shift, as on every compiler we build with
+    Fixed operator*(Fixed other) const { return Fixed{(raw * other.raw) >> FIXED_FRACTION_BITS}; }
+    Fixed operator/(Fixed other) const { return Fixed{raw * FIXED_ONE / other.raw}; }
+    bool operator<(Fixed other) const { return raw < other.raw; }
+    bool operator>=(Fixed other) const { return raw >= other.raw; }
+    bool operator==(Fixed other) const { return raw == other.raw; }
+};
+
+// Quarter sine wave in FIXED_SINE_STEPS segments, built by a Taylor series in
+// 2.30 integer math so the table is the same whatever compiles it
+const int FIXED_SINE_STEPS = 256;
+
+struct FixedSineTable {
+    int32_t values[FIXED_SINE_STEPS + 1];
+
+    constexpr FixedSineTable() : values() {
+        const int64_t halfPi = 1686629713;  // pi/2 in 2.30
+        for (int i = 0; i <= FIXED_SINE_STEPS; i++) {
+            int64_t x = halfPi * i / FIXED_SINE_STEPS;
+            int64_t term = x, sum = x;
+            for (int k = 1; k <= 12 && term != 0; k++) {
+                term = ((term * x) >> 30) * x >> 30;
+                term /= (2 * k) * (2 * k + 1);
+                sum += (k % 2) ? -term : term;
+            }
+            values[i] = static_cast<int32_t>((sum + (1 << 13)) >> 14);  // 2.30 to 16.16
+        }
+    }
+};
+
+constexpr FixedSineTable FIXED_SINE{};
+
+// Sine of an angle in FIXED_TURN units, interpolated between table entries
+inline Fixed fixedSin(int32_t angle) {
+    const int32_t quarter = FIXED_TURN / 4;
+    const int32_t step = quarter / FIXED_SINE_STEPS;
+    uint32_t a = static_cast<uint32_t>(angle) & (FIXED_TURN - 1);
+    uint32_t quadrant = a / quarter;
+    int32_t offset = static_cast<int32_t>(a % quarter);
+    if (quadrant & 1) offset = quarter - offset;
+
+    int index = offset / step;
+    int64_t value = FIXED_SINE.values[index];
+    if (index < FIXED_SINE_STEPS) {
+        value += (FIXED_SINE.values[index + 1] - value) * (offset % step) / step;
+    }
+    return Fixed::fromRaw(quadrant >= 2 ? -value : value);
+}
+
+inline Fixed fixedCos(int32_t angle) {
+    return fixedSin(angle + FIXED_TURN / 4);
+}
+
+// Square root, rounded down, by the bit-at-a-time integer method
+inline Fixed fixedSqrt(Fixed value) {
+    if (value.raw <= 0) return Fixed::fromRaw(0);
+    uint64_t n = static_cast<uint64_t>(value.raw) << FIXED_FRACTION_BITS;
+    uint64_t root = 0;
+    uint64_t bit = uint64_t(1) << 62;
+    while (bit > n) bit >>= 2;
+    while (bit) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return Fixed::fromRaw(static_cast<int64_t>(root));
+}
+
+#endif // BLOCKBREAKER_FIXED_H
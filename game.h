@@ -0,0 +1,1584 @@
+// BlockBreaker - game core: constants, game objects and the game itself
+//
+// Rendering is compiled out when BLOCKBREAKER_HEADLESS is defined, which
+// leaves a core with no GTK or cairo dependency for headless tools.
+
+#ifndef BLOCKBREAKER_GAME_H
+#define BLOCKBREAKER_GAME_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#ifndef BLOCKBREAKER_HEADLESS
+#include <cairo.h>
+#include "render.h"
+#endif
+
+#include "narrowphase.h"
+
+#ifdef BLOCKBREAKER_FIXED_POINT
+#include "fixed.h"
+#endif
+
+// Game constants
+const int WINDOW_WIDTH = 800;
+const int WINDOW_HEIGHT = 600;
+const int PADDLE_WIDTH = 100;
+const int PADDLE_HEIGHT = 20;
+const int BALL_RADIUS = 10;
+const int BLOCK_WIDTH = 80;
+const int BLOCK_HEIGHT = 30;
+const int BLOCK_ROWS = 5;
+const int BLOCK_COLS = 9;
+const int BLOCK_SPACING = 5;
+const int TOP_MARGIN = 50;
+const int SIDE_MARGIN = 20;
+const int MIN_BLOCK_SPACING = 2;   // Keeps block strokes from overlapping in large grids
+const int MAX_FIELD_HEIGHT = WINDOW_HEIGHT / 2 - TOP_MARGIN;
+const int SPRITE_MARGIN = 1;       // Room for the 2px border stroke around block sprites
+const double BALL_SPEED = 5.0;
+const int START_LIVES = 3;
+const int STORM_BALL_RADIUS = 3;   // Ball storm mode packs thousands of balls into the field
+const double NO_HIT = std::numeric_limits<double>::infinity();  // Time of a collision that never happens
+
+// Random numbers for gameplay and block colors. Each game owns one so runs
+// are reproducible from a seed and the state fits in a snapshot
+// (xorshift64*).
+struct Rng {
+    uint64_t state;
+    
+    explicit Rng(uint64_t seed = 1) {
+        reseed(seed);
+    }
+    
+    void reseed(uint64_t seed) {
+        state = seed * 0x9e3779b97f4a7c15ull + 1;  // Never zero for small seeds
+        if (state == 0) state = 1;
+    }
+    
+    uint32_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<uint32_t>((state * 0x2545f4914f6cdd1dull) >> 32);
+    }
+    
+    // Uniform in [0, n)
+    int below(int n) {
+        return static_cast<int>((static_cast<uint64_t>(next()) * static_cast<uint32_t>(n)) >> 32);
+    }
+};
+
+// Game objects
+struct Ball {
+    double x, y;
+    double dx, dy;
+    int radius;
+    
+    Ball() = default;
+    Ball(double startX, double startY, int r) : x(startX), y(startY), radius(r) {
+        // Initial direction: upward at an angle
+#ifdef BLOCKBREAKER_FIXED_POINT
+        Fixed speed = Fixed::fromDouble(BALL_SPEED);
+        dx = (speed * fixedCos(FIXED_TURN / 8)).toDouble();
+        dy = -(speed * fixedSin(FIXED_TURN / 8)).toDouble();
+#else
+        double angle = M_PI / 4.0;  // 45 degrees
+        dx = BALL_SPEED * cos(angle);
+        dy = -BALL_SPEED * sin(angle);
+#endif
+    }
+    
+    void move() {
+        x += dx;
+        y += dy;
+    }
+    
+#ifndef BLOCKBREAKER_HEADLESS
+    void draw(cairo_t* cr, Quality quality) {
+        if (quality != Quality::Full) {
+            // Solid ball, keeping the highlight while we can afford it
+            cairo_set_source_rgb(cr, 1.0, 0.8, 0.0);
+            cairo_arc(cr, x, y, radius, 0, 2 * M_PI);
+            cairo_fill(cr);
+            if (quality == Quality::Bevel) {
+                cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.3);
+                cairo_arc(cr, x - radius/3, y - radius/3, radius/3, 0, 2 * M_PI);
+                cairo_fill(cr);
+            }
+            return;
+        }
+        
+        // Create gradient for 3D effect
+        cairo_pattern_t *gradient = cairo_pattern_create_radial(
+            x - radius/3, y - radius/3, 0,
+            x, y, radius
+        );
+        cairo_pattern_add_color_stop_rgb(gradient, 0.0, 1.0, 1.0, 0.5);  // Bright center
+        cairo_pattern_add_color_stop_rgb(gradient, 0.7, 1.0, 0.8, 0.0);  // Regular yellow
+        cairo_pattern_add_color_stop_rgb(gradient, 1.0, 0.8, 0.6, 0.0);  // Darker edge
+        
+        // Draw ball with gradient
+        cairo_arc(cr, x, y, radius, 0, 2 * M_PI);
+        cairo_set_source(cr, gradient);
+        cairo_fill(cr);
+        cairo_pattern_destroy(gradient);
+        
+        // Add highlight reflection
+        cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.3);
+        cairo_arc(cr, x - radius/3, y - radius/3, radius/3, 0, 2 * M_PI);
+        cairo_fill(cr);
+    }
+#endif
+};
+
+struct Paddle {
+    double x, y;
+    int width, height;
+    
+    Paddle(double startX, double startY, int w, int h) 
+        : x(startX), y(startY), width(w), height(h) {}
+    
+#ifndef BLOCKBREAKER_HEADLESS
+    // Record the paddle into the frame's draw list
+    void draw(DrawList& list, Quality quality) const {
+        double left = x - width/2;
+        double top = y - height/2;
+        
+        if (quality == Quality::Full) {
+            // Gradient for 3D effect: lighter blue top, darker blue bottom
+            list.gradientFill(DrawLayer::Body, left, top, width, height, 0.2, 0.8, 1.0, 0.0, 0.4, 0.8);
+        } else {
+            list.fill(DrawLayer::Body, left, top, width, height, 0.1, 0.6, 0.9);
+            if (quality != Quality::Bevel) return;
+        }
+        
+        // Highlight border (picks up the whole body outline, as for blocks)
+        list.strokeRect(DrawLayer::Highlight, left, top, width, height, 2, 1.0, 1.0, 1.0, 0.5);
+        // Bottom and right shadow
+        list.strokeCorner(DrawLayer::Shadow, left, top, width, height, 2, 0.0, 0.0, 0.3, 0.5);
+        
+        // Inner bevel for extra 3D effect
+        list.fill(DrawLayer::Bevel, left + 3, top + 3, width - 6, height - 6, 0.1, 0.6, 0.9);
+    }
+#endif
+    
+    void move(double newX) {
+#ifdef BLOCKBREAKER_FIXED_POINT
+        newX = Fixed::fromDouble(newX).toDouble();  // Keep the physics on the fixed grid
+#endif
+        // Ensure paddle stays within window bounds
+        if (newX - width / 2 < 0) {
+            x = width / 2;
+        } else if (newX + width / 2 > WINDOW_WIDTH) {
+            x = WINDOW_WIDTH - width / 2;
+        } else {
+            x = newX;
+        }
+    }
+};
+
+struct Block {
+    double x, y;
+    int width, height;
+    bool active;
+    double r, g, b;  // Color
+    
+    Block(double startX, double startY, int w, int h, Rng& rng) 
+        : x(startX), y(startY), width(w), height(h), active(true) {
+        // Assign a random color
+        r = 0.3 + rng.below(70) / 100.0;
+        g = 0.3 + rng.below(70) / 100.0;
+        b = 0.3 + rng.below(70) / 100.0;
+    }
+    
+    Block(double startX, double startY, int w, int h, double red, double green, double blue)
+        : x(startX), y(startY), width(w), height(h), active(true), r(red), g(green), b(blue) {}
+    
+#ifndef BLOCKBREAKER_HEADLESS
+    // Record this block into the frame's draw list
+    void draw(DrawList& list, Quality quality) const {
+        if (!active) return;
+        
+        if (quality == Quality::Full) {
+            // Gradient for 3D effect: lighter top-left, darker bottom-right
+            list.gradientFill(DrawLayer::Body, x, y, width, height,
+                              r * 1.2 > 1.0 ? 1.0 : r * 1.2,
+                              g * 1.2 > 1.0 ? 1.0 : g * 1.2,
+                              b * 1.2 > 1.0 ? 1.0 : b * 1.2,
+                              r * 0.7, g * 0.7, b * 0.7);
+        } else {
+            // Flat body in the bevel color so the lower tiers still read as the same block
+            list.fill(DrawLayer::Body, x, y, width, height, r * 0.8, g * 0.8, b * 0.8);
+            if (quality != Quality::Bevel) return;
+        }
+        
+        // Light border. The body rectangle stays on the path into this stroke,
+        // so it covers all four edges rather than just the top and left.
+        list.strokeRect(DrawLayer::Highlight, x, y, width, height, 2, 1, 1, 1, 0.5);
+        // Shadow on bottom and right edges
+        list.strokeCorner(DrawLayer::Shadow, x, y, width, height, 2, 0, 0, 0, 0.5);
+        
+        // Inner bevel for extra 3D effect
+        if (width > 6 && height > 6) {
+            list.fill(DrawLayer::Bevel, x + 3, y + 3, width - 6, height - 6, r * 0.8, g * 0.8, b * 0.8);
+        }
+    }
+    
+    // Render this block on its own for the sprite cache. Touches nothing
+    // shared, so it may run on any thread.
+    Sprite renderSprite(Quality quality) const {
+        return ::renderSprite(width + 2 * SPRITE_MARGIN, height + 2 * SPRITE_MARGIN,
+                              x - SPRITE_MARGIN, y - SPRITE_MARGIN, [&](cairo_t* spriteCr) {
+            DrawList list;
+            if (quality == Quality::FlatNoAA) {
+                cairo_set_antialias(spriteCr, CAIRO_ANTIALIAS_NONE);
+            }
+            draw(list, quality);
+            list.flush(spriteCr, false);
+        });
+    }
+#endif
+};
+
+// Swept tests for a point moving from (x, y) by (dx, dy) per tick. Each
+// returns the earliest t in [0, limit] at which the point touches the shape,
+// or NO_HIT.
+
+inline double sweepBox(double x, double y, double dx, double dy,
+                       double x0, double y0, double x1, double y1, double limit) {
+    double tEnter = 0, tExit = limit;
+    const double origin[2] = {x, y}, dir[2] = {dx, dy};
+    const double lo[2] = {x0, y0}, hi[2] = {x1, y1};
+    for (int axis = 0; axis < 2; axis++) {
+        if (dir[axis] == 0) {
+            if (origin[axis] < lo[axis] || origin[axis] > hi[axis]) return NO_HIT;
+            continue;
+        }
+        double t0 = (lo[axis] - origin[axis]) / dir[axis];
+        double t1 = (hi[axis] - origin[axis]) / dir[axis];
+        if (t0 > t1) std::swap(t0, t1);
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+        if (tEnter > tExit) return NO_HIT;
+    }
+    return tEnter;
+}
+
+inline double sweepCircle(double x, double y, double dx, double dy,
+                          double cx, double cy, double radius, double limit) {
+    double ox = x - cx, oy = y - cy;
+    double c = ox * ox + oy * oy - radius * radius;
+    if (c <= 0) return 0;
+    double a = dx * dx + dy * dy;
+    double b = ox * dx + oy * dy;
+    if (a == 0 || b >= 0) return NO_HIT;
+    double discriminant = b * b - a * c;
+    if (discriminant < 0) return NO_HIT;
+    double t = (-b - std::sqrt(discriminant)) / a;
+    return t <= limit ? t : NO_HIT;
+}
+
+// A ball against a block: its center against the block grown by the radius,
+// with rounded corners
+inline double sweepBlock(const Ball& ball, const Block& block, double limit) {
+    double r = ball.radius;
+    double x0 = block.x, y0 = block.y;
+    double x1 = block.x + block.width, y1 = block.y + block.height;
+    double t = std::min(sweepBox(ball.x, ball.y, ball.dx, ball.dy, x0 - r, y0, x1 + r, y1, limit),
+                        sweepBox(ball.x, ball.y, ball.dx, ball.dy, x0, y0 - r, x1, y1 + r, limit));
+    t = std::min(t, sweepCircle(ball.x, ball.y, ball.dx, ball.dy, x0, y0, r, limit));
+    t = std::min(t, sweepCircle(ball.x, ball.y, ball.dx, ball.dy, x1, y0, r, limit));
+    t = std::min(t, sweepCircle(ball.x, ball.y, ball.dx, ball.dy, x0, y1, r, limit));
+    t = std::min(t, sweepCircle(ball.x, ball.y, ball.dx, ball.dy, x1, y1, r, limit));
+    return t;
+}
+
+// Broadphase for ball-vs-block tests: a uniform grid over the window that
+// buckets block indices by the cells their rectangles overlap. Built once per
+// level; destroyed blocks stay in their buckets and are skipped when visited.
+// Each bucket entry also carries its block's box in structure-of-arrays form
+// for the batched narrowphase, emptied by setActive() when the block goes.
+struct BlockGrid {
+    double originX = 0, originY = 0;
+    double cellWidth = 1, cellHeight = 1;
+    double boundsX0 = 0, boundsY0 = 0, boundsX1 = 0, boundsY1 = 0;  // Around all blocks
+    int cols = 0, rows = 0;
+    std::vector<uint32_t> cellStart;    // rows * cols + 1 offsets into items
+    std::vector<uint32_t> items;
+    std::vector<double> itemX0, itemY0, itemX1, itemY1, itemIndex;  // Parallel to items
+    std::vector<uint32_t> blockItemStart;   // blocks + 1 offsets into blockItems
+    std::vector<uint32_t> blockItems;       // Item positions of each block
+    
+    // Cells start at (x0, y0), which should be the layout's top-left corner
+    // so that blocks on a regular grid fall into exactly one cell each
+    void build(const std::vector<Block>& blocks, double x0, double y0, double cellW, double cellH) {
+        originX = x0;
+        originY = y0;
+        cellWidth = cellW;
+        cellHeight = cellH;
+        cols = std::max(1, static_cast<int>(std::ceil((WINDOW_WIDTH - originX) / cellWidth)));
+        rows = std::max(1, static_cast<int>(std::ceil((WINDOW_HEIGHT - originY) / cellHeight)));
+        cellStart.assign(static_cast<size_t>(rows) * cols + 1, 0);
+        boundsX0 = boundsY0 = boundsX1 = boundsY1 = 0;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            const Block& block = blocks[i];
+            boundsX0 = i ? std::min(boundsX0, block.x) : block.x;
+            boundsY0 = i ? std::min(boundsY0, block.y) : block.y;
+            boundsX1 = std::max(boundsX1, block.x + block.width);
+            boundsY1 = std::max(boundsY1, block.y + block.height);
+        }
+        
+        // Counting sort: count per cell, prefix-sum, then scatter
+        for (int pass = 0; pass < 2; pass++) {
+            std::vector<uint32_t> fill;
+            if (pass == 1) {
+                for (size_t c = 1; c < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+                items.resize(cellStart.back());
+                fill.assign(cellStart.begin(), cellStart.end() - 1);
+            }
+            for (uint32_t i = 0; i < blocks.size(); i++) {
+                const Block& block = blocks[i];
+                int c0, r0, c1, r1;
+                cellRange(block.x, block.y, block.x + block.width, block.y + block.height, c0, r0, c1, r1);
+                for (int r = r0; r <= r1; r++) {
+                    for (int c = c0; c <= c1; c++) {
+                        size_t cell = static_cast<size_t>(r) * cols + c;
+                        if (pass == 0) cellStart[cell + 1]++;
+                        else items[fill[cell]++] = i;
+                    }
+                }
+            }
+        }
+        
+        // Boxes per item, and the reverse map from blocks to their items
+        size_t count = items.size();
+        itemX0.resize(count);
+        itemY0.resize(count);
+        itemX1.resize(count);
+        itemY1.resize(count);
+        itemIndex.resize(count);
+        blockItemStart.assign(blocks.size() + 1, 0);
+        for (size_t k = 0; k < count; k++) {
+            const Block& block = blocks[items[k]];
+            itemX0[k] = block.active ? block.x : NO_HIT;
+            itemY0[k] = block.y;
+            itemX1[k] = block.x + block.width;
+            itemY1[k] = block.y + block.height;
+            itemIndex[k] = items[k];
+            blockItemStart[items[k] + 1]++;
+        }
+        for (size_t b = 1; b < blockItemStart.size(); b++) blockItemStart[b] += blockItemStart[b - 1];
+        blockItems.resize(count);
+        std::vector<uint32_t> next(blockItemStart.begin(), blockItemStart.end() - 1);
+        for (size_t k = 0; k < count; k++) blockItems[next[items[k]]++] = static_cast<uint32_t>(k);
+    }
+    
+    // Show or hide a block to the batched narrowphase
+    void setActive(uint32_t index, const Block& block) {
+        for (uint32_t k = blockItemStart[index]; k < blockItemStart[index + 1]; k++) {
+            itemX0[blockItems[k]] = block.active ? block.x : NO_HIT;
+        }
+    }
+    
+    // Follow every block moving down by dy, as when the whole field
+    // scrolls; the cells move with them, so no block changes bucket
+    void shiftY(double dy) {
+        originY += dy;
+        boundsY0 += dy;
+        boundsY1 += dy;
+        for (double& y : itemY0) y += dy;
+        for (double& y : itemY1) y += dy;
+    }
+    
+    BoxArrays boxes() const {
+        return {itemX0.data(), itemY0.data(), itemX1.data(), itemY1.data(), itemIndex.data()};
+    }
+    
+    void cellRange(double x0, double y0, double x1, double y1, int& c0, int& r0, int& c1, int& r1) const {
+        c0 = clampCell(std::floor((x0 - originX) / cellWidth), cols);
+        r0 = clampCell(std::floor((y0 - originY) / cellHeight), rows);
+        c1 = clampCell(std::floor((x1 - originX) / cellWidth), cols);
+        r1 = clampCell(std::floor((y1 - originY) / cellHeight), rows);
+    }
+    
+    // Clamped to [0, count) before converting, so far-off blocks land in the
+    // edge cells rather than overflowing the int
+    static int clampCell(double cell, int count) {
+        if (!(cell > 0)) return 0;
+        return cell < count - 1 ? static_cast<int>(cell) : count - 1;
+    }
+    
+    // Visit the cells a point moving from (x, y) by (dx, dy) per tick passes
+    // through during [0, limit], in order, as visit(col, row, tEnter). Cells
+    // follow the grid's spacing but may lie outside it. Stops early when
+    // visit returns false.
+    template <typename Visit>
+    void traverse(double x, double y, double dx, double dy, double limit, Visit visit) const {
+        int col = static_cast<int>(std::floor((x - originX) / cellWidth));
+        int row = static_cast<int>(std::floor((y - originY) / cellHeight));
+        int stepCol = dx > 0 ? 1 : -1, stepRow = dy > 0 ? 1 : -1;
+        double nextX = dx == 0 ? NO_HIT
+                     : (originX + (col + (dx > 0)) * cellWidth - x) / dx;
+        double nextY = dy == 0 ? NO_HIT
+                     : (originY + (row + (dy > 0)) * cellHeight - y) / dy;
+        double deltaX = dx == 0 ? NO_HIT : cellWidth / std::abs(dx);
+        double deltaY = dy == 0 ? NO_HIT : cellHeight / std::abs(dy);
+        
+        double t = 0;
+        while (visit(col, row, t)) {
+            if (nextX < nextY) {
+                t = nextX;
+                nextX += deltaX;
+                col += stepCol;
+            } else {
+                t = nextY;
+                nextY += deltaY;
+                row += stepRow;
+            }
+            if (t > limit) return;
+        }
+    }
+    
+    // Call visit(index) for every block bucketed in a cell the box touches.
+    // A block spanning several cells may be visited more than once.
+    template <typename Visit>
+    void query(double x0, double y0, double x1, double y1, Visit visit) const {
+        querySpans(x0, y0, x1, y1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                visit(items[k]);
+            }
+        });
+    }
+    
+    // The same items as query(), as visit(begin, end) over ranges of item
+    // positions: cells in a row are stored back to back, so each row of the
+    // box is one range
+    template <typename Visit>
+    void querySpans(double x0, double y0, double x1, double y1, Visit visit) const {
+        if (y1 < originY || y0 > WINDOW_HEIGHT || x1 < originX || x0 > WINDOW_WIDTH) return;
+        int c0, r0, c1, r1;
+        cellRange(x0, y0, x1, y1, c0, r0, c1, r1);
+        for (int r = r0; r <= r1; r++) {
+            size_t rowCell = static_cast<size_t>(r) * cols;
+            uint32_t begin = cellStart[rowCell + c0], end = cellStart[rowCell + c1 + 1];
+            if (begin != end) visit(begin, end);
+        }
+    }
+};
+
+// Refers to one block for as long as it stands, from
+// BlockBreakerGame::blockHandle(). A handle outlives its block safely: once
+// the block is destroyed, or another level starts, it no longer resolves.
+struct BlockHandle {
+    uint32_t level = 0;         // Levels started by the game; none is 0
+    uint32_t index = 0;
+    uint32_t generation = 0;
+};
+
+// The standing blocks of a level, packed into a dense array of block
+// indices. Destroying a block swap-removes it, so walking what is left of a
+// level costs what is left rather than the level's starting size. Each block
+// also has a generation, bumped whenever it leaves or re-enters play, which
+// tells a BlockHandle to it from one to an earlier life.
+struct BlockRoster {
+    std::vector<uint32_t> live;         // Indices of standing blocks, in no set order
+    std::vector<uint32_t> position;     // Parallel to blocks: index into live while standing
+    std::vector<uint32_t> generation;   // Parallel to blocks
+    
+    // Start over with the blocks marked active
+    void build(const std::vector<Block>& blocks) {
+        live.clear();
+        live.reserve(blocks.size());
+        position.assign(blocks.size(), 0);
+        generation.assign(blocks.size(), 0);
+        for (uint32_t i = 0; i < blocks.size(); i++) {
+            if (!blocks[i].active) continue;
+            position[i] = static_cast<uint32_t>(live.size());
+            live.push_back(i);
+        }
+    }
+    
+    void add(uint32_t index) {
+        position[index] = static_cast<uint32_t>(live.size());
+        live.push_back(index);
+        generation[index]++;
+    }
+    
+    // The last standing block takes the removed one's place
+    void remove(uint32_t index) {
+        uint32_t moved = live.back();
+        live[position[index]] = moved;
+        position[moved] = position[index];
+        live.pop_back();
+        generation[index]++;
+    }
+};
+
+// Moves values between the game state, which is kept in doubles, and the
+// Scalar a LevelConfig's collision test runs in
+template <typename Scalar>
+struct ScalarOps {
+    static Scalar from(double value) {
+        return static_cast<Scalar>(value);
+    }
+};
+
+#ifdef BLOCKBREAKER_FIXED_POINT
+template <>
+struct ScalarOps<Fixed> {
+    static Fixed from(double value) {
+        return Fixed::fromDouble(value);
+    }
+};
+
+using GameScalar = Fixed;
+#else
+using GameScalar = double;
+#endif
+
+// Compile-time shape of a level for the per-tick collision code, which
+// BlockBreakerGame instantiates once per config. Scalar is the type the
+// ball-vs-block distance test runs in: double, float, or Fixed in the
+// fixed-point build, which uses it for every config. A config with Rows and Cols set is
+// the standard regular layout: block positions and the grid pitch become
+// constants, and the block pass is a fixed 2x2 window of cells with one
+// block each instead of a BlockGrid walk. Rows and Cols of 0 accept any
+// layout. MaxBalls 1 leaves out the ball-vs-ball pass; 0 means no limit.
+template <typename ScalarType, int Rows, int Cols, int MaxBalls>
+struct LevelConfig {
+    using Scalar = ScalarType;
+    static constexpr int ROWS = Rows;
+    static constexpr int COLS = Cols;
+    static constexpr int MAX_BALLS = MaxBalls;
+    static constexpr bool FIXED_GRID = Rows > 0 && Cols > 0;
+    static constexpr int PITCH_X = BLOCK_WIDTH + BLOCK_SPACING;
+    static constexpr int PITCH_Y = BLOCK_HEIGHT + BLOCK_SPACING;
+    
+    // A ball this small overlaps at most 2x2 cells of the fixed grid
+    static constexpr bool fitsWindow(int radius) {
+        return 2 * radius < std::min(PITCH_X, PITCH_Y);
+    }
+};
+
+using StandardLevel = LevelConfig<GameScalar, BLOCK_ROWS, BLOCK_COLS, 1>;
+using StandardStormLevel = LevelConfig<GameScalar, BLOCK_ROWS, BLOCK_COLS, 0>;
+using AnyLevel = LevelConfig<GameScalar, 0, 0, 0>;
+
+// Where a ball's current path reaches the paddle line, from
+// BlockBreakerGame::predictLanding()
+struct LandingPrediction {
+    double x;          // Ball center on the paddle line
+    double time;       // Ticks from now, NO_HIT if the ball never gets there
+    int bounces;       // Wall and ceiling reflections on the way
+    BlockHandle block; // First block in the way, if any
+    double blockTime;  // Ticks until the ball reaches that block, NO_HIT if the path is clear
+    
+    bool clear() const {
+        return blockTime == NO_HIT;
+    }
+};
+
+// A level made ready ahead of time, typically on a worker thread, for
+// BlockBreakerGame::startPrepared(): the blocks, their broadphase grid and
+// roster and,
+// for drawing, the blocks' sprites, which are otherwise all built when the
+// level starts and on its first frame.
+struct PreparedLevel {
+    std::vector<Block> blocks;
+    BlockGrid grid;
+    BlockRoster roster;
+#ifndef BLOCKBREAKER_HEADLESS
+    std::vector<Sprite> sprites;    // Parallel to blocks; empty where not rendered
+    Quality spriteQuality = Quality::Full;
+#endif
+    
+    // Build the grid and roster over the blocks, as
+    // BlockBreakerGame::loadBlocks() would
+    void buildGrid(double originX, double originY, double cellWidth, double cellHeight) {
+        grid.build(blocks, originX, originY, cellWidth, cellHeight);
+        roster.build(blocks);
+    }
+    
+#ifndef BLOCKBREAKER_HEADLESS
+    // Render the sprites the game would render on the first frame
+    void renderSprites(Quality quality) {
+        spriteQuality = quality;
+        sprites.assign(blocks.size(), Sprite());
+        for (size_t i = 0; i < blocks.size(); i++) {
+            const Block& block = blocks[i];
+            if (PixelTarget::isWhole(block.x) && PixelTarget::isWhole(block.y)) {
+                sprites[i] = block.renderSprite(quality);
+            }
+        }
+    }
+#endif
+};
+
+const int SNAPSHOT_MAX_BALLS = 16;
+const int SNAPSHOT_MAX_BLOCKS = 4096;
+
+// The whole mutable state of a game, flattened into one trivially copyable
+// block by BlockBreakerGame::save(). Level layout and block colors are left
+// out, so a snapshot restores into the game it came from or any game on the
+// same level.
+struct GameSnapshot {
+    uint64_t rngState;
+    double paddleX;
+    int score, lives, activeBlocks;
+    int ballRadius, stormBalls;
+    bool gameRunning, gameOver;
+    uint32_t ballCount, blockCount;
+    Ball balls[SNAPSHOT_MAX_BALLS];
+    uint64_t activeBits[SNAPSHOT_MAX_BLOCKS / 64];
+};
+static_assert(std::is_trivially_copyable<GameSnapshot>::value, "snapshots are copied as raw bytes");
+
+// Game class
+class BlockBreakerGame {
+private:
+    friend class EventSimulation;
+    friend class EndlessField;
+    
+    std::vector<Ball> balls;
+    Rng rng;
+    Paddle paddle;
+    std::vector<Block> blocks;
+    BlockGrid blockGrid;
+    BlockRoster roster;
+    uint32_t levelCount;                // Levels started, for BlockHandle
+    bool gameRunning;
+    bool gameOver;
+    int score;
+    int lives;
+    int ballRadius;
+    int stormBalls;                     // Extra balls released on launch
+    bool standardLayout;                // Blocks laid out as by resetGame(BLOCK_ROWS, BLOCK_COLS)
+    bool endless;                       // Blocks keep coming (EndlessField); clearing them is no win
+    std::vector<uint32_t> sweepOrder;   // Ball indices sorted by left edge
+    
+#ifndef BLOCKBREAKER_HEADLESS
+    DrawList frameDraws;
+    bool batchDraws = true;
+    DrawStats lastDrawStats;
+    std::vector<Sprite> blockSprites;  // Parallel to blocks, rendered on first use
+    Quality spriteQuality = Quality::Full;
+    bool useSprites = true;
+    PhaseSpriteCache ballSprites;
+    Quality ballSpriteQuality = Quality::Full;
+    int ballSpriteRadius = 0;
+#endif
+    
+    // Set up the blocks now in place as a fresh level
+    void startLevel(double originX, double originY, double cellWidth, double cellHeight) {
+#ifndef BLOCKBREAKER_HEADLESS
+        blockSprites.clear();
+#endif
+        for (Block& block : blocks) block.active = true;
+        blockGrid.build(blocks, originX, originY, cellWidth, cellHeight);
+        roster.build(blocks);
+        levelCount++;
+        serve();
+    }
+    
+    // Serve a fresh ball and paddle on the level in place
+    void serve() {
+        // Initialize ball
+        balls.clear();
+        balls.emplace_back(WINDOW_WIDTH / 2, WINDOW_HEIGHT - 50, ballRadius);
+        sweepOrder.clear();
+        
+        // Initialize paddle
+        paddle = Paddle(WINDOW_WIDTH / 2, WINDOW_HEIGHT - 30, PADDLE_WIDTH, PADDLE_HEIGHT);
+        
+        standardLayout = false;
+        endless = false;
+        
+        gameRunning = false;
+        gameOver = false;
+    }
+    
+    // Move one ball and resolve its wall, paddle and block collisions
+    template <typename Config>
+    void updateBall(Ball& ball) {
+        ball.move();
+        
+        // Check for collisions with walls
+        if (ball.x - ball.radius <= 0) {
+            ball.x = ball.radius; // Prevent getting stuck on left wall
+            ball.dx = std::abs(ball.dx); // Force moving right
+        } else if (ball.x + ball.radius >= WINDOW_WIDTH) {
+            ball.x = WINDOW_WIDTH - ball.radius; // Prevent getting stuck on right wall
+            ball.dx = -std::abs(ball.dx); // Force moving left
+        }
+        
+        if (ball.y - ball.radius <= 0) {
+            ball.y = ball.radius; // Prevent getting stuck on top wall
+            ball.dy = std::abs(ball.dy); // Force moving down
+        }
+        
+        // Check for collision with paddle
+        if (ball.y + ball.radius >= paddle.y - paddle.height / 2 &&
+            ball.y - ball.radius <= paddle.y + paddle.height / 2 &&
+            ball.x >= paddle.x - paddle.width / 2 &&
+            ball.x <= paddle.x + paddle.width / 2) {
+            
+            bounceOffPaddle(ball);
+        }
+        
+        // Check for collisions with blocks near the ball. Like a scan of the
+        // whole vector, the lowest-indexed block hit wins.
+        size_t hitIndex = blocks.size();
+        int collisionSide = 0; // 0=top, 1=right, 2=bottom, 3=left
+        if (Config::FIXED_GRID) {
+            findFixedGridHit<Config>(ball, hitIndex, collisionSide);
+        } else {
+            // Batched over the boxes in each row of cells, then the side
+            // from the winning block alone
+            NearestBoxFunction nearest = narrowphase().nearest;
+            BoxArrays boxes = blockGrid.boxes();
+            double best = static_cast<double>(blocks.size());
+            double radiusSquared = ball.radius * ball.radius;
+            blockGrid.querySpans(ball.x - ball.radius, ball.y - ball.radius,
+                                 ball.x + ball.radius, ball.y + ball.radius, [&](uint32_t begin, uint32_t end) {
+                best = nearest(boxes, begin, end, ball.x, ball.y, radiusSquared, best);
+            });
+            hitIndex = static_cast<size_t>(best);
+            if (hitIndex != blocks.size()) {
+                const Block& block = blocks[hitIndex];
+                touchesBlock<Config>(ball, block.x, block.y, block.width, block.height, collisionSide);
+            }
+        }
+        
+        if (hitIndex != blocks.size()) {
+            hitBlock(ball, hitIndex, collisionSide);
+        }
+    }
+    
+    // Whether the ball overlaps the block rectangle, and if so which side it
+    // hit
+    template <typename Config>
+    static bool touchesBlock(const Ball& ball, double x, double y, int width, int height, int& side) {
+        using Scalar = typename Config::Scalar;
+        using Ops = ScalarOps<Scalar>;
+        Scalar left = Ops::from(x), top = Ops::from(y);
+        Scalar right = Ops::from(x + width), bottom = Ops::from(y + height);
+        Scalar ballX = Ops::from(ball.x), ballY = Ops::from(ball.y);
+        Scalar radius = Ops::from(ball.radius);
+        
+        // Calculate the closest point on the block to the ball
+        Scalar closestX = std::max(left, std::min(ballX, right));
+        Scalar closestY = std::max(top, std::min(ballY, bottom));
+        
+        // Calculate the distance between the ball and the closest point
+        Scalar distanceX = ballX - closestX;
+        Scalar distanceY = ballY - closestY;
+        Scalar distanceSquared = distanceX * distanceX + distanceY * distanceY;
+        
+        // Check if the distance is less than the ball's radius
+        if (distanceSquared >= radius * radius) return false;
+        side = impactSide(left, top, right, closestX, closestY);
+        return true;
+    }
+    
+    // The block pass on the standard layout: the ball's box touches at most
+    // the 2x2 cells from its top-left corner's cell, each holding the block
+    // with the same row and column, and scanning them in index order makes
+    // the first hit the lowest-indexed one
+    template <typename Config>
+    void findFixedGridHit(const Ball& ball, size_t& hitIndex, int& side) const {
+        int col0 = static_cast<int>(std::floor((ball.x - ball.radius - SIDE_MARGIN) / Config::PITCH_X));
+        int row0 = static_cast<int>(std::floor((ball.y - ball.radius - TOP_MARGIN) / Config::PITCH_Y));
+        for (int dr = 0; dr < 2; dr++) {
+            int row = row0 + dr;
+            if (row < 0 || row >= Config::ROWS) continue;
+            for (int dc = 0; dc < 2; dc++) {
+                int col = col0 + dc;
+                if (col < 0 || col >= Config::COLS) continue;
+                size_t index = static_cast<size_t>(row) * Config::COLS + col;
+                if (!blocks[index].active) continue;
+                if (touchesBlock<Config>(ball, SIDE_MARGIN + col * Config::PITCH_X,
+                                         TOP_MARGIN + row * Config::PITCH_Y, BLOCK_WIDTH, BLOCK_HEIGHT, side)) {
+                    hitIndex = index;
+                    return;
+                }
+            }
+        }
+    }
+    
+    // One tick of ball movement, collisions and lost balls
+    template <typename Config>
+    void stepBalls() {
+        for (auto& ball : balls) {
+            updateBall<Config>(ball);
+        }
+        if (Config::MAX_BALLS == 1) {
+            if (balls.front().y - balls.front().radius > WINDOW_HEIGHT) {
+                balls.clear();
+                sweepOrder.clear();
+            }
+            return;
+        }
+        
+        if (balls.size() > 1) {
+            collideBalls();
+        }
+        
+        // Drop balls that fell below the screen
+        size_t kept = 0;
+        for (size_t i = 0; i < balls.size(); i++) {
+            if (balls[i].y - balls[i].radius <= WINDOW_HEIGHT) {
+                balls[kept++] = balls[i];
+            }
+        }
+        if (kept != balls.size()) {
+            balls.erase(balls.begin() + kept, balls.end());
+            sweepOrder.clear();  // Indices moved; rebuilt by the next sweep
+        }
+    }
+    
+    // Calculate reflection angle based on where the ball hit the paddle
+    void bounceOffPaddle(Ball& ball) const {
+#ifdef BLOCKBREAKER_FIXED_POINT
+        Fixed hitPos = (Fixed::fromDouble(ball.x) - Fixed::fromDouble(paddle.x)) / Fixed::fromInt(paddle.width / 2);
+        // -1 to 1 becomes -60 to 60 degrees; the upward bounce is in the cosine
+        int32_t angle = static_cast<int32_t>(hitPos.raw * FIXED_TURN / (6 * FIXED_ONE));
+        Fixed dx = Fixed::fromDouble(ball.dx), dy = Fixed::fromDouble(ball.dy);
+        Fixed speed = fixedSqrt(dx * dx + dy * dy);
+        ball.dx = (speed * fixedSin(angle)).toDouble();
+        ball.dy = (-speed * fixedCos(angle)).toDouble();
+#else
+        double hitPos = (ball.x - paddle.x) / (paddle.width / 2);  // -1 to 1
+        double angle = hitPos * (M_PI / 3);  // -60 to 60 degrees
+        
+        ball.dy = -std::abs(ball.dy);  // Always bounce upward
+        
+        // Adjust horizontal direction based on hit position
+        double speed = std::sqrt(ball.dx * ball.dx + ball.dy * ball.dy);
+        ball.dx = speed * std::sin(angle);
+        ball.dy = -speed * std::cos(angle);
+#endif
+    }
+    
+    // Determine impact side by checking where the closest point is on the block
+    template <typename Scalar>
+    static int impactSide(Scalar left, Scalar top, Scalar right, Scalar closestX, Scalar closestY) {
+        if (closestX == left) return 3; // Left side
+        if (closestX == right) return 1; // Right side
+        if (closestY == top) return 0; // Top side
+        return 2; // Bottom side
+    }
+    
+    static int impactSide(const Block& block, double closestX, double closestY) {
+        return impactSide(block.x, block.y, block.x + block.width, closestX, closestY);
+    }
+    
+    // Put a block into play or take it out, in the grid and the roster too
+    void setBlockActive(size_t index, bool active) {
+        if (blocks[index].active == active) return;
+        blocks[index].active = active;
+        blockGrid.setActive(static_cast<uint32_t>(index), blocks[index]);
+        if (active) {
+            roster.add(static_cast<uint32_t>(index));
+        } else {
+            roster.remove(static_cast<uint32_t>(index));
+        }
+    }
+    
+    // Destroy a block and bounce the ball off the given side
+    void hitBlock(Ball& ball, size_t index, int collisionSide) {
+        setBlockActive(index, false);
+        score += 10;
+        
+        // Change direction based on which side was hit
+        switch (collisionSide) {
+            case 0: // Top
+            case 2: // Bottom
+                ball.dy = -ball.dy;
+                // Add a slight random horizontal angle variation to make gameplay more interesting
+                ball.dx += jitter();
+                break;
+            case 1: // Right
+            case 3: // Left
+                ball.dx = -ball.dx;
+                // Add a slight random vertical angle variation
+                ball.dy += jitter();
+                break;
+        }
+        
+        normalizeSpeed(ball);
+    }
+    
+    // Random direction change of -0.1 to 0.1
+    double jitter() {
+#ifdef BLOCKBREAKER_FIXED_POINT
+        return (Fixed::ratio(rng.below(100), 500) - Fixed::ratio(1, 10)).toDouble();
+#else
+        return (rng.below(100) / 500.0) - 0.1;
+#endif
+    }
+    
+    // Rescale a ball's velocity to BALL_SPEED to keep it consistent
+    static void normalizeSpeed(Ball& ball) {
+#ifdef BLOCKBREAKER_FIXED_POINT
+        Fixed dx = Fixed::fromDouble(ball.dx), dy = Fixed::fromDouble(ball.dy);
+        Fixed speed = fixedSqrt(dx * dx + dy * dy);
+        Fixed target = Fixed::fromDouble(BALL_SPEED);
+        ball.dx = (dx * target / speed).toDouble();
+        ball.dy = (dy * target / speed).toDouble();
+#else
+        double speed = std::sqrt(ball.dx * ball.dx + ball.dy * ball.dy);
+        ball.dx = (ball.dx / speed) * BALL_SPEED;
+        ball.dy = (ball.dy / speed) * BALL_SPEED;
+#endif
+    }
+    
+    // Ball-vs-ball collisions by sort-and-sweep on x. The order persists
+    // between frames, so the insertion sort only fixes up the few balls that
+    // changed places and the pass stays close to linear.
+    void collideBalls() {
+        auto left = [this](uint32_t i) { return balls[i].x - balls[i].radius; };
+        
+        if (sweepOrder.size() != balls.size()) {
+            sweepOrder.resize(balls.size());
+            for (uint32_t i = 0; i < sweepOrder.size(); i++) sweepOrder[i] = i;
+            std::sort(sweepOrder.begin(), sweepOrder.end(),
+                      [&](uint32_t a, uint32_t b) { return left(a) < left(b); });
+        } else {
+            for (size_t i = 1; i < sweepOrder.size(); i++) {
+                uint32_t item = sweepOrder[i];
+                double key = left(item);
+                size_t j = i;
+                while (j > 0 && left(sweepOrder[j - 1]) > key) {
+                    sweepOrder[j] = sweepOrder[j - 1];
+                    j--;
+                }
+                sweepOrder[j] = item;
+            }
+        }
+        
+        for (size_t i = 0; i < sweepOrder.size(); i++) {
+            Ball& a = balls[sweepOrder[i]];
+            double right = a.x + a.radius;
+            for (size_t j = i + 1; j < sweepOrder.size(); j++) {
+                Ball& b = balls[sweepOrder[j]];
+                if (b.x - b.radius > right) break;  // No later ball can overlap a on x
+                collidePair(a, b);
+            }
+        }
+    }
+    
+    // Equal masses: exchange the velocity components along the contact
+    // normal if approaching, then push the pair apart
+    static void collidePair(Ball& a, Ball& b) {
+#ifdef BLOCKBREAKER_FIXED_POINT
+        Fixed ax = Fixed::fromDouble(a.x), ay = Fixed::fromDouble(a.y);
+        Fixed bx = Fixed::fromDouble(b.x), by = Fixed::fromDouble(b.y);
+        Fixed dx = bx - ax, dy = by - ay;
+        Fixed minDistance = Fixed::fromInt(a.radius + b.radius);
+        Fixed distanceSquared = dx * dx + dy * dy;
+        if (distanceSquared >= minDistance * minDistance || distanceSquared.raw == 0) return;
+        
+        Fixed distance = fixedSqrt(distanceSquared);
+        if (distance.raw == 0) return;
+        Fixed nx = dx / distance, ny = dy / distance;
+        Fixed adx = Fixed::fromDouble(a.dx), ady = Fixed::fromDouble(a.dy);
+        Fixed bdx = Fixed::fromDouble(b.dx), bdy = Fixed::fromDouble(b.dy);
+        Fixed approach = (bdx - adx) * nx + (bdy - ady) * ny;
+        if (approach < Fixed::fromRaw(0)) {
+            a.dx = (adx + approach * nx).toDouble();
+            a.dy = (ady + approach * ny).toDouble();
+            b.dx = (bdx - approach * nx).toDouble();
+            b.dy = (bdy - approach * ny).toDouble();
+        }
+        Fixed push = Fixed::fromRaw((minDistance - distance).raw / 2);
+        a.x = (ax - nx * push).toDouble();
+        a.y = (ay - ny * push).toDouble();
+        b.x = (bx + nx * push).toDouble();
+        b.y = (by + ny * push).toDouble();
+#else
+        double dx = b.x - a.x;
+        double dy = b.y - a.y;
+        double minDistance = a.radius + b.radius;
+        double distanceSquared = dx * dx + dy * dy;
+        if (distanceSquared >= minDistance * minDistance || distanceSquared == 0) return;
+        
+        double distance = std::sqrt(distanceSquared);
+        double nx = dx / distance;
+        double ny = dy / distance;
+        double approach = (b.dx - a.dx) * nx + (b.dy - a.dy) * ny;
+        if (approach < 0) {
+            a.dx += approach * nx;
+            a.dy += approach * ny;
+            b.dx -= approach * nx;
+            b.dy -= approach * ny;
+        }
+        double push = (minDistance - distance) / 2;
+        a.x -= nx * push;
+        a.y -= ny * push;
+        b.x += nx * push;
+        b.y += ny * push;
+#endif
+    }
+    
+#ifndef BLOCKBREAKER_HEADLESS
+    // Composite the balls from their subpixel-phase sprites
+    void drawBallSprites(const PixelTarget& target, Quality quality) {
+        if (ballSprites.empty() || ballSpriteQuality != quality || ballSpriteRadius != ballRadius) {
+            ballSpriteQuality = quality;
+            ballSpriteRadius = ballRadius;
+            Ball model(0, 0, ballRadius);
+            ballSprites.build(model.radius + SPRITE_MARGIN, [&](cairo_t* spriteCr, double x, double y) {
+                if (quality == Quality::FlatNoAA) {
+                    cairo_set_antialias(spriteCr, CAIRO_ANTIALIAS_NONE);
+                }
+                model.x = x;
+                model.y = y;
+                model.draw(spriteCr, quality);
+            });
+        }
+        for (const auto& ball : balls) {
+            ballSprites.blit(target, ball.x, ball.y);
+        }
+    }
+    
+    // Composite pre-rendered block sprites, recording any block that is not
+    // on whole pixels into the draw list instead
+    void drawBlockSprites(const PixelTarget& target, Quality quality) {
+        if (spriteQuality != quality) {
+            blockSprites.clear();
+            spriteQuality = quality;
+        }
+        blockSprites.resize(blocks.size());
+        
+        for (uint32_t i : roster.live) {
+            const Block& block = blocks[i];
+            if (!PixelTarget::isWhole(block.x) || !PixelTarget::isWhole(block.y)) {
+                block.draw(frameDraws, quality);
+                continue;
+            }
+            
+            Sprite& sprite = blockSprites[i];
+            if (sprite.empty()) sprite = block.renderSprite(quality);
+            target.blit(sprite, static_cast<int>(block.x) - SPRITE_MARGIN,
+                        static_cast<int>(block.y) - SPRITE_MARGIN);
+            lastDrawStats.spriteBlits++;
+        }
+    }
+#endif
+    
+public:
+    explicit BlockBreakerGame(uint64_t seed = 1)
+        : rng(seed), paddle(WINDOW_WIDTH / 2, WINDOW_HEIGHT - 30, PADDLE_WIDTH, PADDLE_HEIGHT),
+          levelCount(0), gameRunning(false), gameOver(false), score(0), lives(START_LIVES),
+          ballRadius(BALL_RADIUS), stormBalls(0), standardLayout(false), endless(false) {
+        resetGame();
+    }
+    
+    // Restart the random sequence; takes effect for block colors at the
+    // next resetGame()
+    void seed(uint64_t value) {
+        rng.reseed(value);
+    }
+    
+    void resetGame() {
+        resetGame(BLOCK_ROWS, BLOCK_COLS);
+    }
+    
+    // Start over on the standard level with full lives and no score
+    void newGame() {
+        score = 0;
+        lives = START_LIVES;
+        resetGame();
+    }
+    
+    // Start a level with a rows x cols block grid. Grids larger than the
+    // standard one shrink their blocks to fit the same playfield.
+    void resetGame(int rows, int cols) {
+        // Initialize blocks
+        int blockWidth = BLOCK_WIDTH;
+        int blockHeight = BLOCK_HEIGHT;
+        int spacing = BLOCK_SPACING;
+        if (rows > BLOCK_ROWS || cols > BLOCK_COLS) {
+            spacing = MIN_BLOCK_SPACING;
+            blockWidth = std::max(1, (WINDOW_WIDTH - 2 * SIDE_MARGIN - (cols - 1) * spacing) / cols);
+            blockHeight = std::max(1, (MAX_FIELD_HEIGHT - (rows - 1) * spacing) / rows);
+        }
+        
+        blocks.clear();
+        blocks.reserve(rows * cols);
+        for (int row = 0; row < rows; row++) {
+            for (int col = 0; col < cols; col++) {
+                double blockX = SIDE_MARGIN + col * (blockWidth + spacing);
+                double blockY = TOP_MARGIN + row * (blockHeight + spacing);
+                blocks.emplace_back(blockX, blockY, blockWidth, blockHeight, rng);
+            }
+        }
+        startLevel(SIDE_MARGIN, TOP_MARGIN, blockWidth + spacing, blockHeight + spacing);
+        standardLayout = rows == BLOCK_ROWS && cols == BLOCK_COLS;
+    }
+    
+    // Start a level with the given blocks, e.g. from a level file. The
+    // broadphase grid starts at (originX, originY) with cells of the given
+    // size, which should be about one block each.
+    void loadBlocks(std::vector<Block> layout, double originX, double originY, double cellWidth, double cellHeight) {
+        blocks = std::move(layout);
+        startLevel(originX, originY, cellWidth, cellHeight);
+    }
+    
+    // Start a level prepared ahead of time. Only swaps storage, so it takes
+    // the same time for any level size; level is left holding the previous
+    // level's blocks, grid and sprites, to be freed wherever is convenient.
+    void startPrepared(PreparedLevel& level) {
+        blocks.swap(level.blocks);
+        std::swap(blockGrid, level.grid);
+        std::swap(roster, level.roster);
+        levelCount++;
+#ifndef BLOCKBREAKER_HEADLESS
+        blockSprites.swap(level.sprites);
+        spriteQuality = level.spriteQuality;
+#endif
+        serve();
+    }
+    
+    void start() {
+        gameRunning = true;
+        
+        // Ball storm: release the extra balls from random spots in the lower
+        // half of the field, all heading upward
+        for (int i = 0; i < stormBalls; i++) {
+            double x = ballRadius + rng.below(WINDOW_WIDTH - 2 * ballRadius);
+            double y = WINDOW_HEIGHT / 2 + rng.below(WINDOW_HEIGHT / 2 - 60);
+            balls.emplace_back(x, y, ballRadius);
+#ifdef BLOCKBREAKER_FIXED_POINT
+            int32_t angle = (rng.below(1000) - 500) * FIXED_TURN / 3000;
+            Fixed speed = Fixed::fromDouble(BALL_SPEED);
+            balls.back().dx = (speed * fixedSin(angle)).toDouble();
+            balls.back().dy = (-speed * fixedCos(angle)).toDouble();
+#else
+            double angle = (rng.below(1000) / 1000.0 - 0.5) * (2 * M_PI / 3);
+            balls.back().dx = BALL_SPEED * std::sin(angle);
+            balls.back().dy = -BALL_SPEED * std::cos(angle);
+#endif
+        }
+        sweepOrder.clear();
+    }
+    
+    // Release count extra balls of the given radius on every launch
+    void setBallStorm(int count, int radius) {
+        stormBalls = count;
+        ballRadius = radius;
+        for (auto& ball : balls) {
+            ball.radius = radius;
+        }
+    }
+    
+    size_t ballCount() const {
+        return balls.size();
+    }
+    
+    void movePaddle(double x) {
+        paddle.move(x);
+        
+        // If game hasn't started, move the ball with the paddle
+        if (!gameRunning && !gameOver) {
+            balls.front().x = paddle.x;
+        }
+    }
+    
+    // First active block a ball moving in a straight line touches within
+    // limit ticks, or blocks.size(); the time of impact goes to when. Walks
+    // the grid cells under the ball's center in order, from where it comes
+    // within a radius of the blocks' bounds, and tests the blocks within a
+    // radius of each cell, stopping once no later cell can beat the earliest
+    // hit found.
+    size_t firstBlockOnPath(const Ball& ball, double limit, double& when) const {
+        const BlockGrid& grid = blockGrid;
+        double r = ball.radius;
+        size_t hit = blocks.size();
+        when = NO_HIT;
+        double start = sweepBox(ball.x, ball.y, ball.dx, ball.dy, grid.boundsX0 - r, grid.boundsY0 - r,
+                                grid.boundsX1 + r, grid.boundsY1 + r, limit);
+        if (start == NO_HIT || roster.live.empty()) return hit;
+        
+        double fromX = ball.x + ball.dx * start, fromY = ball.y + ball.dy * start;
+        grid.traverse(fromX, fromY, ball.dx, ball.dy, limit - start, [&](int col, int row, double tEnter) {
+            if (start + tEnter > when) return false;
+            double x0 = grid.originX + col * grid.cellWidth;
+            double y0 = grid.originY + row * grid.cellHeight;
+            // Once past the bounds the line never comes back
+            if (x0 > grid.boundsX1 + r || x0 + grid.cellWidth < grid.boundsX0 - r ||
+                y0 > grid.boundsY1 + r || y0 + grid.cellHeight < grid.boundsY0 - r) return false;
+            grid.query(x0 - r, y0 - r, x0 + grid.cellWidth + r, y0 + grid.cellHeight + r,
+                       [&](uint32_t index) {
+                const Block& block = blocks[index];
+                if (!block.active) return;
+                double t = sweepBlock(ball, block, limit);
+                // Ties go to the lower index, as in the stepped game
+                if (t < when || (t == when && t != NO_HIT && index < hit)) {
+                    when = t;
+                    hit = index;
+                }
+            });
+            return true;
+        });
+        return hit;
+    }
+    
+    // Where the first ball will cross the paddle line if nothing changes its
+    // path. The crossing comes straight from unfolding the reflections off
+    // the side walls and ceiling; the path is then walked leg by leg through
+    // the block grid to report the first block in the way, after which the
+    // crossing is no longer certain.
+    LandingPrediction predictLanding() const {
+        const Ball& ball = balls.front();
+        double r = ball.radius;
+        double lineY = paddle.y - paddle.height / 2 - r;
+        LandingPrediction landing = {ball.x, NO_HIT, 0, BlockHandle(), NO_HIT};
+        
+        // Straight down to the line, or up to the ceiling and back down
+        bool viaCeiling = ball.dy < 0;
+        if (ball.dy == 0) return landing;
+        if (ball.y >= lineY && !viaCeiling) {
+            landing.time = 0;
+            return landing;
+        }
+        landing.time = viaCeiling ? ((ball.y - r) + (lineY - r)) / -ball.dy : (lineY - ball.y) / ball.dy;
+        
+        // Fold the unfolded x back into the field between the side walls
+        double span = WINDOW_WIDTH - 2 * r;
+        double unfolded = ball.x - r + ball.dx * landing.time;
+        double folds = std::floor(unfolded / span);
+        double offset = unfolded - folds * span;
+        landing.x = r + (static_cast<long long>(folds) % 2 == 0 ? offset : span - offset);
+        landing.bounces = static_cast<int>(std::abs(folds)) + (viaCeiling ? 1 : 0);
+        
+        // Walk each straight leg between reflections through the grid
+        Ball leg = ball;
+        double elapsed = 0;
+        while (elapsed < landing.time) {
+            double legTime = landing.time - elapsed;
+            if (leg.dx < 0) legTime = std::min(legTime, std::max(0.0, (r - leg.x) / leg.dx));
+            if (leg.dx > 0) legTime = std::min(legTime, std::max(0.0, (WINDOW_WIDTH - r - leg.x) / leg.dx));
+            if (leg.dy < 0) legTime = std::min(legTime, std::max(0.0, (r - leg.y) / leg.dy));
+            
+            double when;
+            size_t index = firstBlockOnPath(leg, legTime, when);
+            if (index != blocks.size()) {
+                landing.block = blockHandle(index);
+                landing.blockTime = elapsed + when;
+                break;
+            }
+            
+            leg.x += leg.dx * legTime;
+            leg.y += leg.dy * legTime;
+            elapsed += legTime;
+            if (leg.dx < 0 && leg.x <= r) leg.dx = -leg.dx;
+            else if (leg.dx > 0 && leg.x >= WINDOW_WIDTH - r) leg.dx = -leg.dx;
+            if (leg.dy < 0 && leg.y <= r) leg.dy = -leg.dy;
+        }
+        return landing;
+    }
+    
+    bool update() {
+        if (!gameRunning || gameOver) return true;
+        
+        // Pick the instantiation for this level; the standard one is the
+        // common case
+        if (!standardLayout || !StandardLevel::fitsWindow(ballRadius)) {
+            stepBalls<AnyLevel>();
+        } else if (balls.size() == 1) {
+            stepBalls<StandardLevel>();
+        } else {
+            stepBalls<StandardStormLevel>();
+        }
+        
+        // Lose a life once the last ball is gone
+        if (balls.empty()) {
+            lives--;
+            if (lives <= 0) {
+                gameOver = true;
+            }
+            // Reset ball position
+            balls.emplace_back(paddle.x, WINDOW_HEIGHT - 50, ballRadius);
+            if (!gameOver) {
+                gameRunning = false;
+            }
+        }
+        
+        if (roster.live.empty() && !endless) {
+            gameOver = true;  // Player wins
+        }
+        
+        return true;
+    }
+    
+#ifndef BLOCKBREAKER_HEADLESS
+    void draw(cairo_t* cr, Quality quality = Quality::Full) {
+        // Draw background
+        cairo_set_source_rgb(cr, 0.1, 0.1, 0.2);  // Dark blue/black
+        cairo_paint(cr);
+        
+        if (quality == Quality::FlatNoAA) {
+            cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
+        }
+        
+        // Draw blocks and paddle. They never overlap, so the list is free to
+        // regroup them by style. On image surfaces blocks come from the
+        // sprite cache instead.
+        frameDraws.clear();
+        lastDrawStats = DrawStats();
+        PixelTarget target;
+        bool spritePath = useSprites && target.acquire(cr);
+        if (spritePath) {
+            drawBlockSprites(target, quality);
+            cairo_surface_mark_dirty(cairo_get_group_target(cr));
+        } else {
+            for (uint32_t i : roster.live) {
+                blocks[i].draw(frameDraws, quality);
+            }
+        }
+        paddle.draw(frameDraws, quality);
+        int spriteBlits = lastDrawStats.spriteBlits;
+        lastDrawStats = frameDraws.flush(cr, batchDraws);
+        lastDrawStats.spriteBlits = spriteBlits;
+        
+        // Draw balls
+        if (spritePath) {
+            cairo_surface_flush(cairo_get_group_target(cr));
+            drawBallSprites(target, quality);
+            cairo_surface_mark_dirty(cairo_get_group_target(cr));
+        } else {
+            for (auto& ball : balls) {
+                ball.draw(cr, quality);
+            }
+        }
+        
+        // Text and overlays always keep the default antialiasing
+        cairo_set_antialias(cr, CAIRO_ANTIALIAS_DEFAULT);
+        
+        // Draw score and lives
+        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+        cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+        cairo_set_font_size(cr, 20);
+        
+        char scoreText[50];
+        snprintf(scoreText, sizeof(scoreText), "Score: %d", score);
+        cairo_move_to(cr, 20, 30);
+        cairo_show_text(cr, scoreText);
+        
+        char livesText[50];
+        snprintf(livesText, sizeof(livesText), "Lives: %d", lives);
+        cairo_move_to(cr, WINDOW_WIDTH - 100, 30);
+        cairo_show_text(cr, livesText);
+        
+        // Draw game status message
+        if (!gameRunning && !gameOver) {
+            cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.7);
+            cairo_rectangle(cr, WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 30, 300, 60);
+            cairo_fill(cr);
+            
+            cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+            cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+            cairo_set_font_size(cr, 24);
+            cairo_move_to(cr, WINDOW_WIDTH / 2 - 140, WINDOW_HEIGHT / 2 + 10);
+            cairo_show_text(cr, "Click to Start!");
+        } else if (gameOver) {
+            cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.7);
+            cairo_rectangle(cr, WINDOW_WIDTH / 2 - 150, WINDOW_HEIGHT / 2 - 30, 300, 60);
+            cairo_fill(cr);
+            
+            cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+            cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+            cairo_set_font_size(cr, 24);
+            
+            if (lives <= 0) {
+                cairo_move_to(cr, WINDOW_WIDTH / 2 - 140, WINDOW_HEIGHT / 2 + 10);
+                cairo_show_text(cr, "Game Over!");
+            } else {
+                cairo_move_to(cr, WINDOW_WIDTH / 2 - 140, WINDOW_HEIGHT / 2 + 10);
+                cairo_show_text(cr, "You Win!");
+            }
+            
+            cairo_set_font_size(cr, 18);
+            cairo_move_to(cr, WINDOW_WIDTH / 2 - 120, WINDOW_HEIGHT / 2 + 40);
+            cairo_show_text(cr, "Click to Play Again");
+        }
+    }
+    
+    // Group block draws by style (the default) or replay them block by block
+    void setBatchedDrawing(bool batched) {
+        batchDraws = batched;
+    }
+    
+    // Use the pixel-aligned rectangle fast path (the default)
+    void setFastRects(bool enabled) {
+        frameDraws.setFastRects(enabled);
+    }
+    
+    // Blit cached block sprites when drawing to image surfaces (the default)
+    void setSpriteBlocks(bool enabled) {
+        useSprites = enabled;
+    }
+    
+    const DrawStats& drawStats() const {
+        return lastDrawStats;
+    }
+#endif
+    
+    // Flatten the game state into snapshot. Fails if the game has more balls
+    // or blocks than a snapshot holds.
+    bool save(GameSnapshot& snapshot) const {
+        if (balls.size() > SNAPSHOT_MAX_BALLS || blocks.size() > SNAPSHOT_MAX_BLOCKS) return false;
+        return saveTruncated(snapshot);
+    }
+    
+    // As save(), but a game with more balls or blocks than a snapshot holds
+    // keeps only the first ones that fit, and false is returned. A snapshot
+    // cut short on blocks no longer restores into the game.
+    bool saveTruncated(GameSnapshot& snapshot) const {
+        size_t ballCount = std::min<size_t>(balls.size(), SNAPSHOT_MAX_BALLS);
+        size_t blockCount = std::min<size_t>(blocks.size(), SNAPSHOT_MAX_BLOCKS);
+        snapshot.rngState = rng.state;
+        snapshot.paddleX = paddle.x;
+        snapshot.score = score;
+        snapshot.lives = lives;
+        snapshot.activeBlocks = static_cast<int>(roster.live.size());
+        snapshot.ballRadius = ballRadius;
+        snapshot.stormBalls = stormBalls;
+        snapshot.gameRunning = gameRunning;
+        snapshot.gameOver = gameOver;
+        snapshot.ballCount = static_cast<uint32_t>(ballCount);
+        snapshot.blockCount = static_cast<uint32_t>(blockCount);
+        std::copy(balls.begin(), balls.begin() + ballCount, snapshot.balls);
+        
+        // Only the words covering this level's blocks are written
+        for (size_t word = 0; word * 64 < blockCount; word++) {
+            uint64_t bits = 0;
+            size_t end = std::min(blockCount, word * 64 + 64);
+            for (size_t i = word * 64; i < end; i++) {
+                bits |= static_cast<uint64_t>(blocks[i].active) << (i - word * 64);
+            }
+            snapshot.activeBits[word] = bits;
+        }
+        return ballCount == balls.size() && blockCount == blocks.size();
+    }
+    
+    // Return to a saved state. Fails, leaving the game untouched, if the
+    // snapshot was taken on a level with a different number of blocks.
+    bool restore(const GameSnapshot& snapshot) {
+        if (snapshot.blockCount != blocks.size()) return false;
+        rng.state = snapshot.rngState;
+        paddle.x = snapshot.paddleX;
+        score = snapshot.score;
+        lives = snapshot.lives;
+        ballRadius = snapshot.ballRadius;
+        stormBalls = snapshot.stormBalls;
+        gameRunning = snapshot.gameRunning;
+        gameOver = snapshot.gameOver;
+        balls.assign(snapshot.balls, snapshot.balls + snapshot.ballCount);
+        sweepOrder.clear();
+        for (size_t i = 0; i < blocks.size(); i++) {
+            setBlockActive(i, (snapshot.activeBits[i / 64] >> (i % 64)) & 1);
+        }
+        return true;
+    }
+    
+    // Take over other's level: its blocks, broadphase grid and roster, but
+    // none of its render caches. restore() a snapshot of other afterwards
+    // for the rest of its state. Reuses this game's storage where it can.
+    void copyLevel(const BlockBreakerGame& other) {
+        blocks = other.blocks;
+        blockGrid = other.blockGrid;
+        roster = other.roster;
+        paddle = other.paddle;
+        levelCount = other.levelCount;
+        standardLayout = other.standardLayout;
+        endless = other.endless;
+#ifndef BLOCKBREAKER_HEADLESS
+        blockSprites.clear();
+#endif
+    }
+    
+    // Knock every ball slightly off course with the same random jitter as a
+    // block hit, to break the ball out of a bounce loop that never reaches a
+    // block
+    void perturb() {
+        for (Ball& ball : balls) {
+            ball.dx += jitter();
+            ball.dy += jitter();
+            normalizeSpeed(ball);
+        }
+    }
+    
+    bool isGameRunning() const {
+        return gameRunning;
+    }
+    
+    bool isGameOver() const {
+        return gameOver;
+    }
+    
+    int getScore() const {
+        return score;
+    }
+    
+    int getLives() const {
+        return lives;
+    }
+    
+    const std::vector<Ball>& getBalls() const {
+        return balls;
+    }
+    
+    const std::vector<Block>& getBlocks() const {
+        return blocks;
+    }
+    
+    // Indices into getBlocks() of the blocks still standing, in no set order
+    const std::vector<uint32_t>& standingBlocks() const {
+        return roster.live;
+    }
+    
+    // A handle to the block at index, for holding on to across ticks
+    BlockHandle blockHandle(size_t index) const {
+        BlockHandle handle;
+        handle.level = levelCount;
+        handle.index = static_cast<uint32_t>(index);
+        handle.generation = roster.generation[index];
+        return handle;
+    }
+    
+    // The block a handle refers to, or nullptr once it is gone
+    const Block* findBlock(BlockHandle handle) const {
+        if (handle.level != levelCount || handle.index >= blocks.size()) return nullptr;
+        if (roster.generation[handle.index] != handle.generation || !blocks[handle.index].active) return nullptr;
+        return &blocks[handle.index];
+    }
+    
+    const Paddle& getPaddle() const {
+        return paddle;
+    }
+    
+    int remainingBlocks() const {
+        return static_cast<int>(roster.live.size());
+    }
+    
+    // Changes whenever a level starts, so copies of the game can tell
+    // whether they are still on the same one
+    uint32_t levelSerial() const {
+        return levelCount;
+    }
+    
+    // Blocks move between ticks (EndlessField), not only when a level starts
+    bool isEndless() const {
+        return endless;
+    }
+};
+
+#endif // BLOCKBREAKER_GAME_H
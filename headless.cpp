@@ -0,0 +1,865 @@
+// BlockBreaker - headless bot runner
+//
+// Plays games without a display, with a bot that parks the paddle where the
+// ball will cross the paddle line, and reports throughput. Games run either
+// through the stepped update() loop or the event-driven simulation. With
+// --tournament it instead plays every combination of levels, seeds and
+// policies across all cores and reports each game.
+//
+// Compile with:
+// g++ -std=c++17 -O2 -DBLOCKBREAKER_HEADLESS -o blockbreaker-headless headless.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "game.h"
+#include "eventsim.h"
+#include "ai.h"
+#include "tournament.h"
+#include "pixelobs.h"
+#include "shm.h"
+#include "cycle.h"
+#include "cpu.h"
+#include "level.h"
+#include "pack.h"
+#include "prefetch.h"
+#include "endless.h"
+
+// Live state export (--shm), fed from every stepped tick and every event
+static StatePublisher statePublisher;
+
+// Level file every game starts on (--level), instead of the standard level
+static LevelFile levelFile;
+
+// Level pack the tournament draws levels from (--pack)
+static LevelPack levelPack;
+
+// What to do with games caught in a bounce loop (--stuck)
+static StuckAction stuckAction = StuckAction::Perturb;
+
+struct RunTotals {
+    uint64_t ticks = 0;
+    uint64_t events = 0;
+    uint64_t iterations = 0;        // MCTS descents
+    uint64_t simulatedTicks = 0;    // Ticks simulated by MCTS rollouts
+    uint64_t loops = 0;             // Bounce loops detected
+    int stuckGames = 0;             // Games with at least one
+    long long score = 0;
+    int wins = 0;
+    double seconds = 0;
+};
+
+static void countLoops(const CycleDetector& detector, RunTotals& totals) {
+    totals.loops += detector.detections();
+    totals.stuckGames += detector.detections() > 0;
+}
+
+static void playStepped(BlockBreakerGame& game, long maxTicks, RunTotals& totals) {
+    LandingBot bot;
+    CycleDetector detector;
+    long tick = 0;
+    game.start();
+    while (!game.isGameOver() && tick < maxTicks) {
+        game.movePaddle(bot.target(game));
+        game.update();
+        if (!game.isGameRunning() && !game.isGameOver()) {
+            game.start();  // Serve again straight away after a lost life
+        }
+        statePublisher.publish(game, ++tick);
+        if (!checkStuck(detector, game, stuckAction)) break;
+    }
+    totals.ticks += tick;
+    countLoops(detector, totals);
+}
+
+static void playEvents(BlockBreakerGame& game, long maxTicks, RunTotals& totals) {
+    LandingBot bot;
+    CycleDetector detector;
+    EventSimulation sim(game);
+    sim.schedulePaddle(0, bot.target(game));
+    sim.runUntil(maxTicks, [&](SimEvent kind) {
+        statePublisher.publish(game, static_cast<uint64_t>(sim.time()));
+        if (!checkStuck(detector, game, kind, stuckAction)) {
+            sim.stop();
+        } else if (kind != SimEvent::PaddleMove) {
+            sim.schedulePaddle(sim.time(), bot.target(game));
+        }
+    });
+    totals.ticks += static_cast<uint64_t>(sim.time());
+    totals.events += sim.events();
+    countLoops(detector, totals);
+}
+
+// Time save() and restore() on a mid-game standard level
+static int runSnapshotBenchmark() {
+    const int iterations = 1000000;
+    BlockBreakerGame game;
+    LandingBot bot;
+    game.start();
+    for (int tick = 0; tick < 600; tick++) {
+        game.movePaddle(bot.target(game));
+        game.update();
+    }
+    
+    GameSnapshot snapshot;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        game.save(snapshot);
+        asm volatile("" : : "r"(&snapshot) : "memory");
+    }
+    auto saved = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        game.restore(snapshot);
+        asm volatile("" : : "r"(&game) : "memory");
+    }
+    auto restored = std::chrono::steady_clock::now();
+    
+    std::cout << "snapshot: " << sizeof(GameSnapshot) << " bytes, save "
+              << std::chrono::duration<double, std::nano>(saved - start).count() / iterations << " ns, restore "
+              << std::chrono::duration<double, std::nano>(restored - saved).count() / iterations << " ns"
+              << std::endl;
+    return 0;
+}
+
+static void playMcts(BlockBreakerGame& game, MctsPlayer& ai, double budgetMs, long maxTicks,
+                     RunTotals& totals) {
+    CycleDetector detector;
+    long tick = 0;
+    game.start();
+    while (!game.isGameOver() && tick < maxTicks) {
+        game.movePaddle(ai.decide(game, budgetMs));
+        totals.iterations += ai.lastStats().iterations;
+        totals.simulatedTicks += ai.lastStats().simulatedTicks;
+        game.update();
+        if (!game.isGameRunning() && !game.isGameOver()) {
+            game.start();
+        }
+        statePublisher.publish(game, ++tick);
+        if (!checkStuck(detector, game, stuckAction)) break;
+    }
+    totals.ticks += tick;
+    countLoops(detector, totals);
+}
+
+// Split a comma-separated option value
+static std::vector<std::string> splitList(const char* text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Levels are ROWSxCOLS; seeds are single values or FIRST-LAST ranges
+static bool parseLevels(const char* text, std::vector<TournamentLevel>& levels) {
+    for (const std::string& item : splitList(text)) {
+        TournamentLevel level;
+        if (sscanf(item.c_str(), "%dx%d", &level.rows, &level.cols) != 2 || level.rows < 1 || level.cols < 1) {
+            return false;
+        }
+        levels.push_back(level);
+    }
+    return !levels.empty();
+}
+
+static bool parseSeeds(const char* text, std::vector<uint64_t>& seeds) {
+    for (const std::string& item : splitList(text)) {
+        unsigned long long first, last;
+        int fields = sscanf(item.c_str(), "%llu-%llu", &first, &last);
+        if (fields < 1) return false;
+        if (fields == 1) last = first;
+        for (unsigned long long seed = first; seed <= last; seed++) seeds.push_back(seed);
+    }
+    return !seeds.empty();
+}
+
+static bool parsePolicies(const char* text, std::vector<Policy>& policies) {
+    for (const std::string& item : splitList(text)) {
+        Policy policy;
+        if (!parsePolicy(item, policy)) return false;
+        policies.push_back(policy);
+    }
+    return !policies.empty();
+}
+
+// Add the pack's levels FIRST-LAST, or all of them, to the tournament
+static bool addPackLevels(const LevelPack& pack, const char* range, std::vector<TournamentLevel>& levels) {
+    unsigned long first = 0, last = pack.levelCount() - 1;
+    if (range) {
+        int fields = sscanf(range, "%lu-%lu", &first, &last);
+        if (fields < 1) return false;
+        if (fields == 1) last = first;
+    }
+    if (pack.levelCount() == 0 || first > last || last >= pack.levelCount()) return false;
+    for (unsigned long index = first; index <= last; index++) {
+        TournamentLevel level = {0, 0};
+        level.pack = static_cast<int>(index);
+        levels.push_back(level);
+    }
+    return true;
+}
+
+static int runTournamentCli(TournamentConfig& config) {
+    if (config.levels.empty()) config.levels.push_back({BLOCK_ROWS, BLOCK_COLS});
+    if (config.seeds.empty()) {
+        for (uint64_t seed = 1; seed <= 10; seed++) config.seeds.push_back(seed);
+    }
+    if (config.policies.empty()) config.policies = {Policy::Follow, Policy::Landing};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<GameResult> results = runTournament(config);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "level,seed,policy,score,ticks,lives_lost,won,loops,wall_ms\n";
+    for (const GameResult& result : results) {
+        std::cout << levelLabel(config, result.level) << "," << config.seeds[result.seed] << ","
+                  << policyName(config.policies[result.policy]) << "," << result.score << ","
+                  << result.ticks << "," << result.livesLost << "," << result.won << ","
+                  << result.loops << "," << result.wallSeconds * 1000 << "\n";
+    }
+    std::cout << "\n";
+    for (const PolicySummary& summary : summarize(results)) {
+        double games = summary.games;
+        std::cout << levelLabel(config, summary.level) << " " << policyName(config.policies[summary.policy])
+                  << ": " << summary.games << " games, " << summary.wins << " won, mean score "
+                  << summary.score / games << ", mean ticks " << summary.ticks / games
+                  << ", mean lives lost " << summary.livesLost / games << ", stuck " << summary.stuckGames << "\n";
+    }
+    std::cout << results.size() << " games on " << std::max(1u, config.threads) << " threads in "
+              << seconds << " s" << std::endl;
+    return 0;
+}
+
+// Time 84x84 pixel observations of a mid-game standard level, with a hash of
+// the output to compare between runs
+static int runPixelBenchmark() {
+    const int iterations = 200000;
+    BlockBreakerGame game;
+    LandingBot bot;
+    game.start();
+    for (int tick = 0; tick < 600; tick++) {
+        game.movePaddle(bot.target(game));
+        game.update();
+    }
+
+    for (int channels : {1, 3}) {
+        PixelObserver observer(PIXEL_OBS_SIZE, channels);
+        std::vector<uint8_t> pixels(observer.bytes());
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            observer.render(game, pixels.data());
+            asm volatile("" : : "r"(pixels.data()) : "memory");
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t hash = 1469598103934665603ull;  // FNV-1a
+        for (uint8_t byte : pixels) hash = (hash ^ byte) * 1099511628211ull;
+        std::cout << "pixels " << (channels == 1 ? "gray" : "rgb ") << " (" << simdLevelName(simdLevel())
+                  << "): " << us / iterations
+                  << " us/observation, hash " << std::hex << hash << std::dec << std::endl;
+    }
+
+    // The same on a 60x60 level as it empties: the cost follows the blocks
+    // left standing, not the level's size. Blocks are knocked out by
+    // restoring a snapshot with their bits cleared.
+    game.resetGame(60, 60);
+    GameSnapshot snapshot;
+    game.save(snapshot);
+    size_t blocks = game.getBlocks().size();
+    PixelObserver observer;
+    std::vector<uint8_t> pixels(observer.bytes());
+    for (size_t standing : {blocks, blocks / 4, blocks / 100}) {
+        for (size_t i = standing; i < blocks; i++) snapshot.activeBits[i / 64] &= ~(1ull << (i % 64));
+        game.restore(snapshot);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations / 20; i++) {
+            observer.render(game, pixels.data());
+            asm volatile("" : : "r"(pixels.data()) : "memory");
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "pixels gray, " << game.remainingBlocks() << " of " << blocks << " blocks standing: "
+                  << us / (iterations / 20) << " us/observation" << std::endl;
+    }
+    return 0;
+}
+
+// Time stepped ticks on a dense level with each supported narrowphase
+// kernel; the score shows they all play the same game
+static int runNarrowphaseBenchmark() {
+    const int ticks = 200000;
+    SimdLevel best = simdLevel();
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512}) {
+        if (level > best) break;
+        forceSimdLevel(level);
+        BlockBreakerGame game;
+        game.resetGame(400, 400);
+        game.start();
+        auto start = std::chrono::steady_clock::now();
+        for (int tick = 0; tick < ticks && !game.isGameOver(); tick++) {
+            game.movePaddle(game.getBalls().front().x);
+            game.update();
+            if (!game.isGameRunning() && !game.isGameOver()) game.start();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "narrowphase " << narrowphase().name << ": 400x400 level, " << ns / ticks
+                  << " ns/tick, score " << game.getScore() << std::endl;
+    }
+    forceSimdLevel(best);
+    return 0;
+}
+
+// Convert a text level to the binary format
+static int convertLevel(const char* textPath, const char* outPath) {
+    std::ifstream text(textPath);
+    if (!text) {
+        std::cerr << "Could not read " << textPath << std::endl;
+        return 1;
+    }
+    LevelSource level;
+    std::string error;
+    if (!parseLevelText(text, level, error)) {
+        std::cerr << textPath << ": " << error << std::endl;
+        return 1;
+    }
+    if (!writeLevelFile(level, outPath)) {
+        std::cerr << "Could not write " << outPath << ", or the level lies too far from the window" << std::endl;
+        return 1;
+    }
+    size_t blocks = level.layout == LevelLayout::Grid ? level.cells.size() : level.boxes.size();
+    std::cout << outPath << ": " << blocks << (level.layout == LevelLayout::Grid ? " cells" : " boxes") << ", "
+              << level.palette.size() << " block types" << std::endl;
+    return 0;
+}
+
+// Build a pack from text levels, named after the pack file
+static int buildPack(const char* outPath, int count, char** textPaths) {
+    std::string name = outPath;
+    name = name.substr(name.find_last_of('/') + 1);
+    name = name.substr(0, name.find('.'));
+    LevelPackWriter writer;
+    if (!writer.open(outPath, name)) {
+        std::cerr << "Could not write " << outPath << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        std::ifstream text(textPaths[i]);
+        LevelSource level;
+        std::string error;
+        if (!text) {
+            std::cerr << "Could not read " << textPaths[i] << std::endl;
+            return 1;
+        }
+        if (!parseLevelText(text, level, error)) {
+            std::cerr << textPaths[i] << ": " << error << std::endl;
+            return 1;
+        }
+        if (!writer.add(level)) {
+            std::cerr << "Could not write " << outPath << std::endl;
+            return 1;
+        }
+    }
+    if (!writer.finish()) {
+        std::cerr << "Could not write " << outPath << std::endl;
+        return 1;
+    }
+    std::cout << outPath << ": " << writer.levelCount() << " levels" << std::endl;
+    return 0;
+}
+
+// Print a pack's catalog from its index, without reading any level
+static int listPack(const char* path) {
+    LevelPack pack;
+    if (!pack.open(path)) {
+        std::cerr << "Could not load level pack " << path << std::endl;
+        return 1;
+    }
+    std::cout << "index,name,blocks,difficulty,thumbnail\n";
+    for (size_t i = 0; i < pack.levelCount(); i++) {
+        const LevelPackEntry& entry = pack.entry(i);
+        std::cout << i << "," << std::string(entry.name, strnlen(entry.name, LEVEL_NAME_SIZE)) << ","
+                  << entry.blockCount << "," << entry.difficulty << "," << std::hex << entry.thumbnailHash
+                  << std::dec << "\n";
+    }
+    std::cout << pack.name() << ": " << pack.levelCount() << " levels" << std::endl;
+    return 0;
+}
+
+// A file made from a mkstemp() template, closed and removed again when it
+// goes out of scope
+class TempFile {
+private:
+    int fd;
+
+public:
+    std::string path;
+
+    explicit TempFile(const char* pattern) : path(pattern) {
+        fd = mkstemp(&path[0]);
+    }
+    TempFile(const TempFile&) = delete;
+    TempFile& operator=(const TempFile&) = delete;
+
+    ~TempFile() {
+        if (fd < 0) return;
+        ::close(fd);
+        unlink(path.c_str());
+    }
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+};
+
+// Time mapping and starting a 1000x1000 grid level, written to a temporary
+// file first. The second run finds the file in the page cache; the last one
+// has the level prepared in the background first, as between levels in play.
+static int runLevelBenchmark() {
+    LevelSource source;
+    source.layout = LevelLayout::Grid;
+    source.rows = source.cols = 1000;
+    source.blockWidth = source.blockHeight = 1;
+    source.spacing = MIN_BLOCK_SPACING;
+    source.palette = {{230, 80, 60, 1}, {90, 90, 220, 1}, {80, 200, 90, 1}};
+    Rng rng(1);
+    for (uint32_t i = 0; i < source.rows * source.cols; i++) {
+        source.cells.push_back(static_cast<uint8_t>(rng.below(3)));
+    }
+    TempFile file("/tmp/blockbreaker-levelXXXXXX");
+    const char* path = file.path.c_str();
+    if (!file.isOpen() || !writeLevelFile(source, path)) {
+        std::cerr << "Could not write a temporary level" << std::endl;
+        return 1;
+    }
+
+    BlockBreakerGame game;
+    for (int run = 0; run < 2; run++) {
+        LevelFile level;
+        auto start = std::chrono::steady_clock::now();
+        bool opened = level.open(path);
+        auto mapped = std::chrono::steady_clock::now();
+        if (opened) loadLevel(game, level);
+        auto loaded = std::chrono::steady_clock::now();
+        if (!opened) {
+            std::cerr << "Could not map " << path << std::endl;
+            break;
+        }
+        std::cout << "level 1000x1000: map " << std::chrono::duration<double, std::milli>(mapped - start).count()
+                  << " ms, load " << std::chrono::duration<double, std::milli>(loaded - mapped).count()
+                  << " ms, " << game.getBlocks().size() << " blocks" << std::endl;
+    }
+
+    LevelFile level;
+    if (level.open(path)) {
+        LevelPrefetcher prefetcher;
+        prefetcher.request(0, [&](PreparedLevel& prepared) {
+            prepareLevel(level, prepared);
+            return true;
+        });
+        std::this_thread::sleep_for(std::chrono::seconds(1));  // A level's worth of play
+        auto start = std::chrono::steady_clock::now();
+        prefetcher.start(0, game);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "level 1000x1000: prefetched start " << ms << " ms, " << game.getBlocks().size()
+                  << " blocks" << std::endl;
+    }
+    return 0;
+}
+
+// Spread the bits of v apart, to the even bits of the result
+static uint64_t mortonSpread(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffull;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ffull;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+// Reorder blocks along the Z-order (Morton) curve through the cells of a
+// grid from (originX, originY), so blocks close on screen are close in
+// memory too. Blocks in one cell keep their order.
+static void sortBlocksMorton(std::vector<Block>& blocks, double originX, double originY,
+                             double cellWidth, double cellHeight) {
+    auto cell = [](double offset, double size) {
+        return static_cast<uint32_t>(std::max(0.0, std::min(double(UINT32_MAX), std::floor(offset / size))));
+    };
+    std::vector<std::pair<uint64_t, uint32_t>> order(blocks.size());
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+        uint32_t col = cell(blocks[i].x - originX, cellWidth), row = cell(blocks[i].y - originY, cellHeight);
+        order[i] = {mortonSpread(col) | mortonSpread(row) << 1, i};
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<Block> sorted;
+    sorted.reserve(blocks.size());
+    for (const auto& entry : order) sorted.push_back(blocks[entry.second]);
+    blocks.swap(sorted);
+}
+
+// Compare block storage orders on a million-block map: 1x1 blocks on a
+// 1000x1000 lattice squeezed into the window, stored row by row as they
+// were emplaced and again along the Z-order curve. Times starting the level
+// and swept-ball queries from random points in the field, which read the
+// blocks in the cells around each path. Both orders find the same number
+// of hits; which of two touching blocks wins differs, as ties go to the
+// lower index.
+static int runMortonBenchmark() {
+    const int queries = 200000;
+    const double originX = 25, originY = 25, pitchX = 0.75, pitchY = 0.55;
+    const double cellWidth = 2 * pitchX, cellHeight = 2 * pitchY;
+    std::vector<Block> rowMajor;
+    Rng rng(1);
+    for (int row = 0; row < 1000; row++) {
+        for (int col = 0; col < 1000; col++) {
+            rowMajor.emplace_back(originX + col * pitchX, originY + row * pitchY, 1, 1, rng);
+        }
+    }
+    std::vector<Block> morton = rowMajor;
+    auto sortStart = std::chrono::steady_clock::now();
+    sortBlocksMorton(morton, originX, originY, cellWidth, cellHeight);
+    double sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sortStart).count();
+    std::cout << "morton: sorted " << morton.size() << " blocks in " << sortMs << " ms" << std::endl;
+
+    for (int order = 0; order < 2; order++) {
+        BlockBreakerGame game;
+        auto start = std::chrono::steady_clock::now();
+        game.loadBlocks(order == 0 ? rowMajor : morton, originX, originY, cellWidth, cellHeight);
+        auto loaded = std::chrono::steady_clock::now();
+
+        Rng queryRng(2);
+        int hits = 0;
+        for (int i = 0; i < queries; i++) {
+            Ball ball(originX + queryRng.below(750), originY + queryRng.below(550), 3);
+            double angle = queryRng.below(3600) * M_PI / 1800;
+            ball.dx = BALL_SPEED * std::cos(angle);
+            ball.dy = BALL_SPEED * std::sin(angle);
+            double when;
+            hits += game.firstBlockOnPath(ball, 20, when) != game.getBlocks().size();
+        }
+        auto queried = std::chrono::steady_clock::now();
+        std::cout << (order == 0 ? "row-major" : "morton   ") << ": start "
+                  << std::chrono::duration<double, std::milli>(loaded - start).count() << " ms, queries "
+                  << std::chrono::duration<double, std::micro>(queried - loaded).count() / queries
+                  << " us each, " << hits << " hits" << std::endl;
+    }
+    return 0;
+}
+
+// Play endless mode for 16 hours of game time with the landing bot, starting
+// over whenever a game ends, and report each hour: tick cost and peak memory
+// should stay flat while rows keep coming
+static int runEndlessBenchmark() {
+    const long hourTicks = 60L * 60 * 60;
+    BlockBreakerGame game;
+    EndlessField field(game, 1);
+    LandingBot bot;
+    field.reset();
+    game.start();
+    uint64_t rows = 0, recycled = 0;
+    int games = 1;
+    for (int hour = 1; hour <= 16; hour++) {
+        auto start = std::chrono::steady_clock::now();
+        for (long tick = 0; tick < hourTicks; tick++) {
+            if (game.isGameOver()) {
+                rows += field.rows();
+                recycled += field.chunksRecycled();
+                field.reset();
+                games++;
+            }
+            if (!game.isGameRunning()) game.start();
+            game.movePaddle(bot.target(game));
+            game.update();
+            field.step();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        std::cout << "endless hour " << hour << ": " << ns / hourTicks << " ns/tick, " << games << " games, "
+                  << rows + field.rows() << " rows, " << recycled + field.chunksRecycled() << " chunks recycled, "
+                  << EndlessField::poolBlocks() << " pool blocks, peak RSS " << usage.ru_maxrss << " KB"
+                  << std::endl;
+    }
+    return 0;
+}
+
+// One event-driven game for --check-stuck, played by a paddle that takes
+// a random lane of the landing point for every return, and whether it
+// ever looped as CycleDetector sees it: among the collisions since the last
+// score or life change, the last period's worth (and CYCLE_CONFIRM more at
+// least) each within half a hash step of the one a period earlier
+struct StuckCheckGame {
+    int score = 0;
+    uint64_t events = 0;
+    double ticks = 0;
+    uint64_t loops = 0;
+    bool repeated = false;
+};
+
+static StuckCheckGame playStuckCheck(uint64_t seed, StuckAction action) {
+    struct Collision {
+        SimEvent kind;
+        double paddleX, x, y, dx, dy;
+        bool near(const Collision& other) const {
+            const double position = CYCLE_POSITION_STEP / 2, velocity = CYCLE_VELOCITY_STEP / 2;
+            return kind == other.kind && std::abs(paddleX - other.paddleX) < position &&
+                   std::abs(x - other.x) < position && std::abs(y - other.y) < position &&
+                   std::abs(dx - other.dx) < velocity && std::abs(dy - other.dy) < velocity;
+        }
+    };
+    BlockBreakerGame game(seed);
+    LandingTracker tracker;
+    Rng lanes(seed);
+    int lane = 0;
+    CycleDetector detector;
+    EventSimulation sim(game);
+    std::vector<Collision> history;
+    int score = -1, lives = -1;
+    StuckCheckGame result;
+    sim.schedulePaddle(0, tracker.landing(game));
+    sim.runUntil(100000, [&](SimEvent kind) {
+        if (game.getScore() != score || game.getLives() != lives) {
+            score = game.getScore();
+            lives = game.getLives();
+            history.clear();
+        }
+        if (kind != SimEvent::PaddleMove) {
+            const Ball& ball = game.getBalls().front();
+            history.push_back({kind, game.getPaddle().x, ball.x, ball.y, ball.dx, ball.dy});
+            size_t n = history.size();
+            for (size_t period = 1; period <= CYCLE_RING; period++) {
+                size_t span = period + std::max<size_t>(period, CYCLE_CONFIRM);
+                if (span > n) break;
+                bool same = true;
+                for (size_t i = n - span + period; i < n && same; i++) same = history[i].near(history[i - period]);
+                result.repeated |= same;
+            }
+        }
+        if (!checkStuck(detector, game, kind, action)) {
+            sim.stop();
+            return;
+        }
+        if (kind == SimEvent::PaddleMove) return;
+        if (kind == SimEvent::Paddle) lane = lanes.below(5) - 2;
+        sim.schedulePaddle(sim.time(), tracker.landing(game) - lane * (PADDLE_WIDTH / 6.0));
+    });
+    result.score = game.getScore();
+    result.events = sim.events();
+    result.ticks = sim.time();
+    result.loops = detector.detections();
+    return result;
+}
+
+// Check that the loop detector leaves event-driven games alone unless they
+// really loop: a game whose collisions never repeat a whole period must
+// report no loop and play the same with --stuck perturb as with it off
+static int runStuckCheck() {
+    const int games = 200;
+    int clean = 0, failures = 0;
+    for (uint64_t seed = 1; seed <= games; seed++) {
+        StuckCheckGame plain = playStuckCheck(seed, StuckAction::Ignore);
+        if (plain.repeated) continue;
+        clean++;
+        StuckCheckGame perturbed = playStuckCheck(seed, StuckAction::Perturb);
+        if (perturbed.loops || perturbed.score != plain.score || perturbed.events != plain.events ||
+            perturbed.ticks != plain.ticks) {
+            std::cout << "seed " << seed << ": perturbed " << perturbed.loops << " times without a loop"
+                      << std::endl;
+            failures++;
+        }
+    }
+    std::cout << "stuck check: " << clean << " of " << games << " event games never loop, " << failures
+              << " of them perturbed" << std::endl;
+    return failures || clean < games / 2 ? 1 : 0;
+}
+
+static void usage() {
+    std::cout << "Usage: blockbreaker-headless [options]\n"
+              << "  --games N       Games per mode (default 1000)\n"
+              << "  --seed S        Base random seed (default 1)\n"
+              << "  --mode M        step, event, both or mcts (default both)\n"
+              << "  --max-ticks T   Tick limit per game (default 100000)\n"
+              << "  --ai-budget MS  MCTS search time per tick (default 2)\n"
+              << "  --threads N     MCTS threads (default: all cores)\n"
+              << "  --stuck A       Bounce loops: off, end or perturb (default perturb)\n"
+              << "  --level FILE    Play every game on a binary level file\n"
+              << "  --convert-level TEXT OUT  Write the binary form of a text level\n"
+              << "  --build-pack OUT TEXT...  Write a level pack of text levels, in order\n"
+              << "  --list-pack FILE  Print a level pack's catalog\n"
+              << "  --shm NAME      Publish live state to POSIX shared memory NAME\n"
+              << "  --simd L        Force SIMD kernels: scalar, sse2, avx2 or avx512\n"
+              << "                  (default: best supported; give before --bench-*)\n"
+              << "  --bench-snapshot  Time snapshot save and restore\n"
+              << "  --bench-pixels  Time 84x84 pixel observations\n"
+              << "  --bench-narrowphase  Time ball-vs-block kernels on a dense level\n"
+              << "  --bench-endless Play 16 hours of endless mode and report the cost per hour\n"
+              << "  --bench-level   Time mapping, loading and prefetching a million-block level\n"
+              << "  --bench-morton  Compare row-major and Z-order block storage on a million-block map\n"
+              << "  --check-stuck   Check that event-driven games without a bounce loop are left alone\n"
+              << "\n"
+              << "Tournament: blockbreaker-headless --tournament [options]\n"
+              << "  --levels L      Comma-separated ROWSxCOLS layouts (default 5x9)\n"
+              << "  --seeds S       Comma-separated seeds or FIRST-LAST ranges (default 1-10)\n"
+              << "  --policies P    Any of follow, landing, mcts (default follow,landing)\n"
+              << "  --pack FILE     Play levels from a level pack, after any --levels\n"
+              << "  --pack-levels R Pack levels to play as FIRST-LAST (default all)\n"
+              << "  --mcts-iterations N  MCTS descents per tick (default 64)\n"
+              << "  --threads N, --max-ticks T, --stuck A as above\n";
+}
+
+int main(int argc, char** argv) {
+    int games = 1000;
+    unsigned seed = 1;
+    std::string mode = "both";
+    long maxTicks = 100000;
+    double aiBudget = 2;
+    unsigned threads = std::thread::hardware_concurrency();
+    bool tournament = false;
+    const char* packRange = nullptr;
+    TournamentConfig config;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        SimdLevel level;
+        if (strcmp(argv[i], "--simd") == 0 && hasValue && parseSimdLevel(argv[i + 1], level)) {
+            if (!forceSimdLevel(level)) {
+                std::cerr << "This CPU does not support " << simdLevelName(level) << std::endl;
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--bench-snapshot") == 0) {
+            return runSnapshotBenchmark();
+        } else if (strcmp(argv[i], "--bench-pixels") == 0) {
+            return runPixelBenchmark();
+        } else if (strcmp(argv[i], "--bench-narrowphase") == 0) {
+            return runNarrowphaseBenchmark();
+        } else if (strcmp(argv[i], "--bench-endless") == 0) {
+            return runEndlessBenchmark();
+        } else if (strcmp(argv[i], "--bench-level") == 0) {
+            return runLevelBenchmark();
+        } else if (strcmp(argv[i], "--bench-morton") == 0) {
+            return runMortonBenchmark();
+        } else if (strcmp(argv[i], "--check-stuck") == 0) {
+            return runStuckCheck();
+        } else if (strcmp(argv[i], "--convert-level") == 0 && i + 2 < argc) {
+            return convertLevel(argv[i + 1], argv[i + 2]);
+        } else if (strcmp(argv[i], "--build-pack") == 0 && hasValue) {
+            return buildPack(argv[i + 1], argc - i - 2, argv + i + 2);
+        } else if (strcmp(argv[i], "--list-pack") == 0 && hasValue) {
+            return listPack(argv[i + 1]);
+        } else if (strcmp(argv[i], "--pack") == 0 && hasValue) {
+            if (!levelPack.open(argv[++i])) {
+                std::cerr << "Could not load level pack " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pack-levels") == 0 && hasValue) {
+            packRange = argv[++i];
+        } else if (strcmp(argv[i], "--level") == 0 && hasValue) {
+            if (!levelFile.open(argv[++i])) {
+                std::cerr << "Could not load level " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tournament") == 0) {
+            tournament = true;
+        } else if (strcmp(argv[i], "--levels") == 0 && hasValue && parseLevels(argv[i + 1], config.levels)) {
+            i++;
+        } else if (strcmp(argv[i], "--seeds") == 0 && hasValue && parseSeeds(argv[i + 1], config.seeds)) {
+            i++;
+        } else if (strcmp(argv[i], "--policies") == 0 && hasValue &&
+                   parsePolicies(argv[i + 1], config.policies)) {
+            i++;
+        } else if (strcmp(argv[i], "--mcts-iterations") == 0 && hasValue) {
+            config.mctsIterations = std::max(1L, atol(argv[++i]));
+        } else if (strcmp(argv[i], "--games") == 0 && hasValue) {
+            games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            seed = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--mode") == 0 && hasValue) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "--max-ticks") == 0 && hasValue) {
+            maxTicks = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--stuck") == 0 && hasValue && parseStuckAction(argv[i + 1], stuckAction)) {
+            i++;
+        } else if (strcmp(argv[i], "--shm") == 0 && hasValue) {
+            if (!statePublisher.open(argv[++i])) {
+                std::cerr << "Could not create shared memory segment " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ai-budget") == 0 && hasValue) {
+            aiBudget = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threads = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        } else {
+            usage();
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    if (tournament) {
+        config.maxTicks = maxTicks;
+        config.threads = threads;
+        config.stuck = stuckAction;
+        if (levelPack.isOpen()) {
+            if (!addPackLevels(levelPack, packRange, config.levels)) {
+                std::cerr << "No such levels in the pack" << std::endl;
+                return 1;
+            }
+            config.pack = &levelPack;
+        }
+        return runTournamentCli(config);
+    }
+
+    std::unique_ptr<MctsPlayer> ai;
+    for (const char* name : {"step", "event", "mcts"}) {
+        bool mcts = strcmp(name, "mcts") == 0;
+        if (mode != name && (mode != "both" || mcts)) continue;
+        bool events = strcmp(name, "event") == 0;
+        if (mcts) ai = std::make_unique<MctsPlayer>(threads);
+
+        RunTotals totals;
+        auto start = std::chrono::steady_clock::now();
+        for (int g = 0; g < games; g++) {
+            BlockBreakerGame game(seed + g);
+            if (levelFile.isOpen()) loadLevel(game, levelFile);
+            if (mcts) {
+                playMcts(game, *ai, aiBudget, maxTicks, totals);
+            } else if (events) {
+                playEvents(game, maxTicks, totals);
+            } else {
+                playStepped(game, maxTicks, totals);
+            }
+            totals.score += game.getScore();
+            if (game.isGameOver() && game.getLives() > 0) totals.wins++;
+        }
+        totals.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double realSeconds = totals.ticks / 60.0;
+        std::cout << name << ": " << games << " games, " << totals.wins << " won, mean score "
+                  << (games ? static_cast<double>(totals.score) / games : 0) << ", "
+                  << totals.ticks << " ticks";
+        if (events) std::cout << " (" << totals.events << " events)";
+        std::cout << " in " << totals.seconds << " s, "
+                  << (totals.seconds > 0 ? realSeconds / totals.seconds : 0) << "x real time" << std::endl;
+        if (stuckAction != StuckAction::Ignore) {
+            std::cout << "stuck: " << totals.loops << " bounce loops in " << totals.stuckGames << " games ("
+                      << stuckActionName(stuckAction) << ")" << std::endl;
+        }
+        if (mcts) {
+            std::cout << "mcts: " << ai->threads() << " threads, " << totals.iterations << " rollouts, "
+                      << (totals.seconds > 0 ? totals.simulatedTicks / totals.seconds : 0)
+                      << " simulated ticks/s" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,432 @@
+// BlockBreaker - binary level files
+//
+// A level file is a fixed header followed by a palette of block types and
+// then the blocks themselves, all little-endian, naturally aligned and
+// addressed by offsets in the header. LevelFile maps the file read-only and
+// checks the header and bounds once (every box, for the boxes layout); the
+// palette, boxes and grid cells are then read from the mapping as they are.
+// Starting a level is not free, though: prepareLevel() copies every record
+// into the game's Block array and builds the broadphase grid over it, which
+// is most of the time a large level takes to start. LevelPrefetcher does
+// that ahead of play. Blocks come in one of two layouts: free boxes
+// (16 bytes each) or a grid with one type byte per cell, which keeps a
+// 1000x1000 level to a megabyte.
+//
+// Levels are written from a line-based text form:
+//
+//   blockbreaker-level 1
+//   name Castle
+//   difficulty 3               # optional, 1-65535
+//   palette 230 80 60 1        # type 0: red, breaks in one hit
+//   palette 90 90 220 3        # type 1
+//   grid 2 4 30 15 5 20 50     # rows cols blockW blockH spacing originX originY
+//   row 0.10
+//   row 1..1
+//
+// where a row has one character per cell, '.' for empty or a type 0-9, a-z,
+// or instead of a grid any number of
+//
+//   block 120 80 60 20 1       # x y width height type
+//
+// Hit points are stored per type for future levels; the game currently
+// breaks every block in one hit.
+
+#ifndef BLOCKBREAKER_LEVEL_H
+#define BLOCKBREAKER_LEVEL_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "game.h"
+
+const char LEVEL_MAGIC[8] = {'B', 'B', 'L', 'E', 'V', 'E', 'L', 0};
+const uint32_t LEVEL_VERSION = 1;
+const uint8_t LEVEL_EMPTY_CELL = 0xff;
+const int LEVEL_MAX_TYPES = 36;         // Types a text grid row can name
+const int LEVEL_NAME_SIZE = 32;
+const double LEVEL_MAX_GRID_CELLS = 1 << 22;   // Broadphase cells a level may ask for
+
+enum class LevelLayout : uint32_t {
+    Boxes = 0,
+    Grid = 1
+};
+
+struct LevelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(LevelHeader), for layout checks
+    uint64_t fileSize;
+    LevelLayout layout;
+    uint32_t paletteCount;
+    uint64_t paletteOffset;
+    uint64_t blocksOffset;
+    uint32_t blockCount;        // Boxes, or rows * cols cells
+    uint32_t rows, cols;        // Grid only
+    uint16_t blockWidth, blockHeight, spacing, reserved;  // Grid only
+    float originX, originY;     // Grid origin, or the boxes' top left
+    float pitchX, pitchY;       // Broadphase cell size
+    uint32_t flags;             // None yet; zero
+    char name[LEVEL_NAME_SIZE];
+};
+
+struct LevelType {
+    uint8_t r, g, b;
+    uint8_t hitPoints;
+};
+
+struct LevelBox {
+    float x, y;
+    uint16_t width, height;
+    uint16_t type;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(LevelHeader) == 120, "level header layout is part of the file format");
+static_assert(sizeof(LevelType) == 4 && sizeof(LevelBox) == 16, "level records are part of the file format");
+static_assert(std::is_trivially_copyable<LevelHeader>::value, "level header is written as raw bytes");
+
+// A level laid out in memory: a whole level file, or one level in a pack
+class LevelView {
+protected:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    const uint8_t* at(uint64_t offset) const {
+        return data + offset;
+    }
+
+    // The header describes a level of this size with every table inside it
+    bool valid() const {
+        if (size < sizeof(LevelHeader)) return false;
+        const LevelHeader& h = header();
+        if (memcmp(h.magic, LEVEL_MAGIC, sizeof(h.magic)) != 0) return false;
+        if (h.version != LEVEL_VERSION || h.headerSize != sizeof(LevelHeader) || h.fileSize != size) return false;
+        if (h.paletteCount == 0 || h.paletteCount > LEVEL_EMPTY_CELL) return false;
+        if (h.paletteOffset % alignof(LevelType) || h.blocksOffset % alignof(LevelBox)) return false;
+        if (h.paletteOffset > size || (size - h.paletteOffset) / sizeof(LevelType) < h.paletteCount) return false;
+        if (h.layout != LevelLayout::Boxes && h.layout != LevelLayout::Grid) return false;
+        if (h.layout == LevelLayout::Grid && uint64_t(h.rows) * h.cols != h.blockCount) return false;
+        uint64_t recordSize = h.layout == LevelLayout::Boxes ? sizeof(LevelBox) : 1;
+        if (h.blocksOffset > size || (size - h.blocksOffset) / recordSize < h.blockCount) return false;
+
+        // The broadphase grid over the window stays a sensible size: cells
+        // of at least a pixel from a finite origin, and not too many of them
+        if (!std::isfinite(h.originX) || !std::isfinite(h.originY)) return false;
+        if (!(h.pitchX >= 1) || !(h.pitchY >= 1)) return false;
+        double cols = std::max(1.0, std::ceil((WINDOW_WIDTH - double(h.originX)) / h.pitchX));
+        double rows = std::max(1.0, std::ceil((WINDOW_HEIGHT - double(h.originY)) / h.pitchY));
+        if (cols * rows > LEVEL_MAX_GRID_CELLS) return false;
+        if (h.layout == LevelLayout::Boxes) {
+            const LevelBox* box = boxes();
+            for (uint32_t i = 0; i < h.blockCount; i++) {
+                if (!std::isfinite(box[i].x) || !std::isfinite(box[i].y)) return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    // Point at a level in memory, which must stay in place while the view
+    // is used. Returns false, leaving the view empty, if it is not a level
+    // this version understands.
+    bool attach(const void* memory, size_t bytes) {
+        data = static_cast<const uint8_t*>(memory);
+        size = bytes;
+        if (!data || !valid()) {
+            data = nullptr;
+            size = 0;
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const {
+        return data != nullptr;
+    }
+
+    const LevelHeader& header() const {
+        return *reinterpret_cast<const LevelHeader*>(data);
+    }
+
+    const LevelType* palette() const {
+        return reinterpret_cast<const LevelType*>(at(header().paletteOffset));
+    }
+
+    // Boxes layout only
+    const LevelBox* boxes() const {
+        return reinterpret_cast<const LevelBox*>(at(header().blocksOffset));
+    }
+
+    // Grid layout only: a type per cell in row order, or LEVEL_EMPTY_CELL
+    const uint8_t* cells() const {
+        return at(header().blocksOffset);
+    }
+
+    // Type of block i, wrapped into the palette so a bad index cannot read
+    // past it
+    const LevelType& type(uint32_t index) const {
+        return palette()[index % header().paletteCount];
+    }
+};
+
+// A level file mapped into memory
+class LevelFile : public LevelView {
+public:
+    LevelFile() = default;
+    LevelFile(const LevelFile&) = delete;
+    LevelFile& operator=(const LevelFile&) = delete;
+
+    ~LevelFile() {
+        close();
+    }
+
+    // Map a level file. Returns false, leaving nothing open, if it cannot
+    // be read or is not a level this version understands.
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        void* memory = MAP_FAILED;
+        size_t bytes = 0;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            bytes = static_cast<size_t>(info.st_size);
+            memory = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (memory == MAP_FAILED) return false;
+        if (!attach(memory, bytes)) {
+            munmap(memory, bytes);
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+};
+
+// Build a level's blocks and broadphase grid, e.g. on a worker thread
+// ahead of play
+inline void prepareLevel(const LevelView& level, PreparedLevel& prepared) {
+    const LevelHeader& h = level.header();
+    std::vector<Block>& blocks = prepared.blocks;
+    blocks.clear();
+    blocks.reserve(h.blockCount);
+    auto add = [&](double x, double y, int width, int height, uint32_t type) {
+        const LevelType& t = level.type(type);
+        blocks.emplace_back(x, y, width, height, t.r / 255.0, t.g / 255.0, t.b / 255.0);
+    };
+    if (h.layout == LevelLayout::Grid) {
+        const uint8_t* cell = level.cells();
+        for (uint32_t row = 0; row < h.rows; row++) {
+            double y = h.originY + row * double(h.blockHeight + h.spacing);
+            for (uint32_t col = 0; col < h.cols; col++, cell++) {
+                if (*cell == LEVEL_EMPTY_CELL) continue;
+                add(h.originX + col * double(h.blockWidth + h.spacing), y, h.blockWidth, h.blockHeight, *cell);
+            }
+        }
+    } else {
+        const LevelBox* box = level.boxes();
+        for (uint32_t i = 0; i < h.blockCount; i++, box++) {
+            add(box->x, box->y, box->width, box->height, box->type);
+        }
+    }
+    prepared.buildGrid(h.originX, h.originY, h.pitchX, h.pitchY);
+}
+
+// Start the game on a level
+inline void loadLevel(BlockBreakerGame& game, const LevelView& level) {
+    PreparedLevel prepared;
+    prepareLevel(level, prepared);
+    game.startPrepared(prepared);
+}
+
+// A level being built from text, in the file's own records
+struct LevelSource {
+    std::string name;
+    int difficulty = 0;         // As rated by the author, or 0 for none
+    std::vector<LevelType> palette;
+    LevelLayout layout = LevelLayout::Boxes;
+    uint32_t rows = 0, cols = 0;
+    uint16_t blockWidth = 0, blockHeight = 0, spacing = 0;
+    float originX = SIDE_MARGIN, originY = TOP_MARGIN;
+    std::vector<uint8_t> cells;
+    std::vector<LevelBox> boxes;
+};
+
+// Read the text form. Returns false with a message naming the line on the
+// first error.
+inline bool parseLevelText(std::istream& in, LevelSource& level, std::string& error) {
+    level = LevelSource();
+    std::string line;
+    int number = 0;
+    bool versioned = false;
+    auto fail = [&](const std::string& message) {
+        error = "line " + std::to_string(number) + ": " + message;
+        return false;
+    };
+    while (std::getline(in, line)) {
+        number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string keyword;
+        if (!(words >> keyword)) continue;
+
+        if (!versioned) {
+            int version = 0;
+            if (keyword != "blockbreaker-level" || !(words >> version) || version != 1) {
+                return fail("expected 'blockbreaker-level 1'");
+            }
+            versioned = true;
+        } else if (keyword == "name") {
+            std::getline(words >> std::ws, level.name);
+            if (level.name.size() >= LEVEL_NAME_SIZE) return fail("name too long");
+        } else if (keyword == "difficulty") {
+            if (!(words >> level.difficulty) || level.difficulty < 1 || level.difficulty > UINT16_MAX) {
+                return fail("expected 'difficulty N' with N from 1 to 65535");
+            }
+        } else if (keyword == "palette") {
+            int r, g, b, hitPoints = 1;
+            if (!(words >> r >> g >> b)) return fail("expected 'palette R G B [HP]'");
+            words >> hitPoints;
+            if (r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255 || hitPoints < 1 || hitPoints > 255) {
+                return fail("palette values must be 0-255 and hit points 1-255");
+            }
+            if (level.palette.size() == LEVEL_MAX_TYPES) return fail("too many block types");
+            level.palette.push_back({uint8_t(r), uint8_t(g), uint8_t(b), uint8_t(hitPoints)});
+        } else if (keyword == "grid") {
+            long rows, cols, width, height, spacing;
+            if (!level.boxes.empty() || level.layout == LevelLayout::Grid) return fail("one grid per level, without blocks");
+            if (!(words >> rows >> cols >> width >> height >> spacing >> level.originX >> level.originY)) {
+                return fail("expected 'grid ROWS COLS WIDTH HEIGHT SPACING X Y'");
+            }
+            if (rows < 1 || cols < 1 || rows * cols > UINT32_MAX || width < 1 || height < 1 || spacing < 0 ||
+                width + spacing > UINT16_MAX || height + spacing > UINT16_MAX) {
+                return fail("grid size out of range");
+            }
+            level.layout = LevelLayout::Grid;
+            level.rows = uint32_t(rows);
+            level.cols = uint32_t(cols);
+            level.blockWidth = uint16_t(width);
+            level.blockHeight = uint16_t(height);
+            level.spacing = uint16_t(spacing);
+            level.cells.reserve(size_t(rows) * cols);
+        } else if (keyword == "row") {
+            std::string cells;
+            words >> cells;
+            if (level.layout != LevelLayout::Grid) return fail("row before grid");
+            if (cells.size() != level.cols) return fail("row needs " + std::to_string(level.cols) + " cells");
+            if (level.cells.size() == size_t(level.rows) * level.cols) return fail("more rows than the grid has");
+            for (char c : cells) {
+                int type = c == '.' ? LEVEL_EMPTY_CELL
+                         : c >= '0' && c <= '9' ? c - '0'
+                         : c >= 'a' && c <= 'z' ? c - 'a' + 10 : -1;
+                if (type < 0 || (type != LEVEL_EMPTY_CELL && type >= int(level.palette.size()))) {
+                    return fail(std::string("no block type '") + c + "'");
+                }
+                level.cells.push_back(uint8_t(type));
+            }
+        } else if (keyword == "block") {
+            double x, y;
+            long width, height, type;
+            if (level.layout == LevelLayout::Grid) return fail("blocks cannot follow a grid");
+            if (!(words >> x >> y >> width >> height >> type)) return fail("expected 'block X Y WIDTH HEIGHT TYPE'");
+            if (width < 1 || width > UINT16_MAX || height < 1 || height > UINT16_MAX) return fail("bad block size");
+            if (type < 0 || type >= long(level.palette.size())) return fail("no block type " + std::to_string(type));
+            level.boxes.push_back({float(x), float(y), uint16_t(width), uint16_t(height), uint16_t(type), 0});
+        } else {
+            return fail("unknown keyword '" + keyword + "'");
+        }
+    }
+    if (!versioned) return fail("empty level");
+    if (level.palette.empty()) return fail("no palette");
+    if (level.layout == LevelLayout::Grid && level.cells.size() != size_t(level.rows) * level.cols) {
+        return fail("grid has " + std::to_string(level.cells.size() / level.cols) + " of " +
+                    std::to_string(level.rows) + " rows");
+    }
+    return true;
+}
+
+// The binary form of a level, as a level file holds it
+inline std::vector<uint8_t> encodeLevel(const LevelSource& level) {
+    LevelHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LEVEL_MAGIC, sizeof(h.magic));
+    h.version = LEVEL_VERSION;
+    h.headerSize = sizeof(LevelHeader);
+    h.layout = level.layout;
+    h.paletteCount = static_cast<uint32_t>(level.palette.size());
+    h.paletteOffset = sizeof(LevelHeader);
+    h.blocksOffset = h.paletteOffset + h.paletteCount * sizeof(LevelType);
+    h.blocksOffset = (h.blocksOffset + alignof(LevelBox) - 1) / alignof(LevelBox) * alignof(LevelBox);
+    strncpy(h.name, level.name.c_str(), LEVEL_NAME_SIZE - 1);
+
+    const void* blocks;
+    size_t blocksSize;
+    if (level.layout == LevelLayout::Grid) {
+        h.blockCount = level.rows * level.cols;
+        h.rows = level.rows;
+        h.cols = level.cols;
+        h.blockWidth = level.blockWidth;
+        h.blockHeight = level.blockHeight;
+        h.spacing = level.spacing;
+        h.originX = level.originX;
+        h.originY = level.originY;
+        h.pitchX = float(level.blockWidth + level.spacing);
+        h.pitchY = float(level.blockHeight + level.spacing);
+        blocks = level.cells.data();
+        blocksSize = level.cells.size();
+    } else {
+        // Broadphase cells as large as the largest box, from the top left one
+        h.blockCount = static_cast<uint32_t>(level.boxes.size());
+        h.originX = h.originY = level.boxes.empty() ? 0 : 1e30f;
+        h.pitchX = h.pitchY = 1;
+        for (const LevelBox& box : level.boxes) {
+            h.originX = std::min(h.originX, box.x);
+            h.originY = std::min(h.originY, box.y);
+            h.pitchX = std::max(h.pitchX, float(box.width));
+            h.pitchY = std::max(h.pitchY, float(box.height));
+        }
+        blocks = level.boxes.data();
+        blocksSize = level.boxes.size() * sizeof(LevelBox);
+    }
+    h.fileSize = h.blocksOffset + blocksSize;
+
+    std::vector<uint8_t> bytes(h.fileSize, 0);
+    memcpy(bytes.data(), &h, sizeof(h));
+    memcpy(bytes.data() + h.paletteOffset, level.palette.data(), h.paletteCount * sizeof(LevelType));
+    if (blocksSize) memcpy(bytes.data() + h.blocksOffset, blocks, blocksSize);
+    return bytes;
+}
+
+// Write the binary form. Returns false if the file cannot be written, or
+// if the level is one LevelView would refuse to load, e.g. laid out too far
+// from the window.
+inline bool writeLevelFile(const LevelSource& level, const char* path) {
+    std::vector<uint8_t> bytes = encodeLevel(level);
+    LevelView check;
+    if (!check.attach(bytes.data(), bytes.size())) return false;
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && written;
+}
+
+#endif // BLOCKBREAKER_LEVEL_H
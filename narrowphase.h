@@ -0,0 +1,131 @@
+// BlockBreaker - batched ball-vs-block narrowphase
+//
+// Tests one ball against a run of block boxes stored as separate x0, y0,
+// x1, y1 arrays: clamp the ball center into each box, take the squared
+// distance, compare with the radius squared, and keep the smallest block
+// index among the hits with a vector min instead of a branch per block.
+// The AVX2 kernel takes 4 boxes per step and the AVX-512 one 8; both stay in
+// double precision with the scalar kernel's operations in the same order,
+// so every kernel finds the same block. A destroyed block's box has
+// x0 = infinity, which never hits.
+
+#ifndef BLOCKBREAKER_NARROWPHASE_H
+#define BLOCKBREAKER_NARROWPHASE_H
+
+#include <algorithm>
+#include <cstddef>
+
+#include "cpu.h"
+
+struct BoxArrays {
+    const double* x0;
+    const double* y0;
+    const double* x1;
+    const double* y1;
+    const double* index;   // Block index per box, as a double for the vector min
+};
+
+// Smallest index among boxes [begin, end) within reach of the ball, or best
+// if that is smaller
+inline double nearestBoxScalar(const BoxArrays& boxes, size_t begin, size_t end,
+                               double x, double y, double radiusSquared, double best) {
+    for (size_t k = begin; k < end; k++) {
+        double closestX = std::max(boxes.x0[k], std::min(x, boxes.x1[k]));
+        double closestY = std::max(boxes.y0[k], std::min(y, boxes.y1[k]));
+        double distanceX = x - closestX;
+        double distanceY = y - closestY;
+        double distanceSquared = distanceX * distanceX + distanceY * distanceY;
+        if (distanceSquared < radiusSquared && boxes.index[k] < best) best = boxes.index[k];
+    }
+    return best;
+}
+
+#ifdef BLOCKBREAKER_X86
+
+// No FMA in the target, so the distance rounds exactly as in the scalar kernel
+__attribute__((target("avx2")))
+inline double nearestBoxAvx2(const BoxArrays& boxes, size_t begin, size_t end,
+                             double x, double y, double radiusSquared, double best) {
+    const __m256d bx = _mm256_set1_pd(x), by = _mm256_set1_pd(y);
+    const __m256d r2 = _mm256_set1_pd(radiusSquared);
+    __m256d found = _mm256_set1_pd(best);
+    size_t k = begin;
+    for (; k + 4 <= end; k += 4) {
+        __m256d closestX = _mm256_max_pd(_mm256_loadu_pd(boxes.x0 + k),
+                                         _mm256_min_pd(bx, _mm256_loadu_pd(boxes.x1 + k)));
+        __m256d closestY = _mm256_max_pd(_mm256_loadu_pd(boxes.y0 + k),
+                                         _mm256_min_pd(by, _mm256_loadu_pd(boxes.y1 + k)));
+        __m256d distanceX = _mm256_sub_pd(bx, closestX);
+        __m256d distanceY = _mm256_sub_pd(by, closestY);
+        __m256d distanceSquared = _mm256_add_pd(_mm256_mul_pd(distanceX, distanceX),
+                                                _mm256_mul_pd(distanceY, distanceY));
+        __m256d hit = _mm256_cmp_pd(distanceSquared, r2, _CMP_LT_OQ);
+        found = _mm256_min_pd(found, _mm256_blendv_pd(found, _mm256_loadu_pd(boxes.index + k), hit));
+    }
+    __m128d pair = _mm_min_pd(_mm256_castpd256_pd128(found), _mm256_extractf128_pd(found, 1));
+    best = std::min(_mm_cvtsd_f64(pair), _mm_cvtsd_f64(_mm_unpackhi_pd(pair, pair)));
+    return nearestBoxScalar(boxes, k, end, x, y, radiusSquared, best);
+}
+
+// The tail runs masked, with missing lanes loaded as empty boxes. AVX-512
+// brings FMA with it; the masked arithmetic forms (all lanes set) are opaque
+// to the optimizer, so the distance is not fused into one, and they also
+// avoid GCC 12's uninitialized warnings on the plain forms.
+__attribute__((target("avx512f")))
+inline double nearestBoxAvx512(const BoxArrays& boxes, size_t begin, size_t end,
+                               double x, double y, double radiusSquared, double best) {
+    const __m512d bx = _mm512_set1_pd(x), by = _mm512_set1_pd(y);
+    const __m512d r2 = _mm512_set1_pd(radiusSquared);
+    const __m512d empty = _mm512_set1_pd(__builtin_inf());
+    const __mmask8 all = 0xff;
+    __m512d found = _mm512_set1_pd(best);
+    for (size_t k = begin; k < end; k += 8) {
+        __mmask8 lanes = end - k >= 8 ? 0xff : static_cast<__mmask8>((1u << (end - k)) - 1);
+        __m512d x0 = _mm512_mask_loadu_pd(empty, lanes, boxes.x0 + k);
+        __m512d y0 = _mm512_mask_loadu_pd(empty, lanes, boxes.y0 + k);
+        __m512d x1 = _mm512_mask_loadu_pd(empty, lanes, boxes.x1 + k);
+        __m512d y1 = _mm512_mask_loadu_pd(empty, lanes, boxes.y1 + k);
+        __m512d closestX = _mm512_mask_max_pd(x0, all, x0, _mm512_mask_min_pd(bx, all, bx, x1));
+        __m512d closestY = _mm512_mask_max_pd(y0, all, y0, _mm512_mask_min_pd(by, all, by, y1));
+        __m512d distanceX = _mm512_sub_pd(bx, closestX);
+        __m512d distanceY = _mm512_sub_pd(by, closestY);
+        __m512d squareX = _mm512_mask_mul_pd(distanceX, all, distanceX, distanceX);
+        __m512d squareY = _mm512_mask_mul_pd(distanceY, all, distanceY, distanceY);
+        __m512d distanceSquared = _mm512_mask_add_pd(squareX, all, squareX, squareY);
+        __mmask8 hit = _mm512_mask_cmp_pd_mask(lanes, distanceSquared, r2, _CMP_LT_OQ);
+        found = _mm512_mask_min_pd(found, hit, found, _mm512_mask_loadu_pd(found, hit, boxes.index + k));
+    }
+    // Fold the halves, quarters and pairs onto lane 0
+    found = _mm512_mask_min_pd(found, all, found, _mm512_mask_shuffle_f64x2(found, all, found, found, 0x4e));
+    found = _mm512_mask_min_pd(found, all, found, _mm512_mask_shuffle_f64x2(found, all, found, found, 0xb1));
+    found = _mm512_mask_min_pd(found, all, found, _mm512_mask_permute_pd(found, all, found, 0x55));
+    return _mm512_cvtsd_f64(found);
+}
+
+#endif // BLOCKBREAKER_X86
+
+typedef double (*NearestBoxFunction)(const BoxArrays& boxes, size_t begin, size_t end,
+                                     double x, double y, double radiusSquared, double best);
+
+struct Narrowphase {
+    NearestBoxFunction nearest;
+    const char* name;
+};
+
+// The kernel for the current simdLevel()
+inline const Narrowphase& narrowphase() {
+    static const Narrowphase scalar = {nearestBoxScalar, "scalar"};
+#ifdef BLOCKBREAKER_X86
+    static const Narrowphase kernels[] = {
+        scalar,
+        scalar,     // SSE2's two lanes are not worth the shuffles
+        {nearestBoxAvx2, "avx2"},
+        {nearestBoxAvx512, "avx512"},
+    };
+    return kernels[static_cast<int>(simdLevel())];
+#else
+    return scalar;
+#endif
+}
+
+#endif // BLOCKBREAKER_NARROWPHASE_H
@@ -0,0 +1,265 @@
+// BlockBreaker - level packs
+//
+// A level pack is one file holding any number of levels, each stored as a
+// complete level file (level.h) at an aligned offset, with an index of
+// offsets and per-level metadata at the end. LevelPack maps the whole file
+// but only checks the header and index on open, so listing a pack of
+// thousands of levels touches the index pages alone; a level's own pages
+// are read when it is opened for play, or ahead of time with prefetch().
+//
+// The metadata lets a campaign menu or a tournament pick levels without
+// opening them: the block count, a difficulty (the author's rating, else the
+// hits needed to clear the level), and a hash of the palette and blocks,
+// which is everything a thumbnail shows, to key cached thumbnails by.
+
+#ifndef BLOCKBREAKER_PACK_H
+#define BLOCKBREAKER_PACK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "level.h"
+
+const char LEVEL_PACK_MAGIC[8] = {'B', 'B', 'P', 'A', 'C', 'K', 0, 0};
+const uint32_t LEVEL_PACK_VERSION = 1;
+const uint64_t LEVEL_PACK_ALIGN = 16;   // Level offsets, enough for every record
+
+struct LevelPackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(LevelPackHeader), for layout checks
+    uint64_t fileSize;
+    uint64_t indexOffset;
+    uint32_t levelCount;
+    uint32_t entrySize;         // sizeof(LevelPackEntry)
+    char name[LEVEL_NAME_SIZE];
+};
+
+struct LevelPackEntry {
+    uint64_t offset;            // Of the level's header, from the start of the pack
+    uint64_t size;
+    uint64_t thumbnailHash;
+    uint32_t blockCount;        // Blocks to break, not counting empty grid cells
+    uint16_t difficulty;
+    uint16_t flags;             // None yet; zero
+    char name[LEVEL_NAME_SIZE];
+};
+
+static_assert(sizeof(LevelPackHeader) == 72, "pack header layout is part of the file format");
+static_assert(sizeof(LevelPackEntry) == 64, "pack index layout is part of the file format");
+
+// FNV-1a over the level from its palette on, leaving out the header and name
+inline uint64_t levelThumbnailHash(const LevelView& level) {
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(&level.header()) + level.header().paletteOffset;
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(&level.header()) + level.header().fileSize;
+    uint64_t hash = 1469598103934665603ull;
+    for (const uint8_t* byte = begin; byte < end; byte++) hash = (hash ^ *byte) * 1099511628211ull;
+    return hash;
+}
+
+// Index entry for a level, with offset and size left for the writer
+inline LevelPackEntry describeLevel(const LevelView& level, int difficulty) {
+    const LevelHeader& h = level.header();
+    uint64_t blocks = 0, hits = 0;
+    auto count = [&](uint32_t type) {
+        blocks++;
+        hits += level.type(type).hitPoints;
+    };
+    if (h.layout == LevelLayout::Grid) {
+        for (uint32_t i = 0; i < h.blockCount; i++) {
+            if (level.cells()[i] != LEVEL_EMPTY_CELL) count(level.cells()[i]);
+        }
+    } else {
+        for (uint32_t i = 0; i < h.blockCount; i++) count(level.boxes()[i].type);
+    }
+
+    LevelPackEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.thumbnailHash = levelThumbnailHash(level);
+    entry.blockCount = static_cast<uint32_t>(blocks);
+    entry.difficulty = static_cast<uint16_t>(difficulty > 0 ? difficulty : std::min<uint64_t>(hits, UINT16_MAX));
+    memcpy(entry.name, h.name, LEVEL_NAME_SIZE);
+    return entry;
+}
+
+class LevelPack {
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    const LevelPackHeader& header() const {
+        return *reinterpret_cast<const LevelPackHeader*>(data);
+    }
+
+    // The header and every index entry lie inside the file
+    bool valid() const {
+        if (size < sizeof(LevelPackHeader)) return false;
+        const LevelPackHeader& h = header();
+        if (memcmp(h.magic, LEVEL_PACK_MAGIC, sizeof(h.magic)) != 0) return false;
+        if (h.version != LEVEL_PACK_VERSION || h.headerSize != sizeof(LevelPackHeader)) return false;
+        if (h.entrySize != sizeof(LevelPackEntry) || h.fileSize != size) return false;
+        if (h.indexOffset % alignof(LevelPackEntry)) return false;
+        if (h.indexOffset > size || (size - h.indexOffset) / sizeof(LevelPackEntry) < h.levelCount) return false;
+        for (uint32_t i = 0; i < h.levelCount; i++) {
+            const LevelPackEntry& e = entry(i);
+            if (e.offset % LEVEL_PACK_ALIGN || e.offset > size || size - e.offset < e.size) return false;
+        }
+        return true;
+    }
+
+public:
+    LevelPack() = default;
+    LevelPack(const LevelPack&) = delete;
+    LevelPack& operator=(const LevelPack&) = delete;
+
+    ~LevelPack() {
+        close();
+    }
+
+    // Map a pack and check its index. Returns false, leaving nothing open,
+    // if it cannot be read or is not a pack this version understands.
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        void* memory = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            size = static_cast<size_t>(info.st_size);
+            memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            size = 0;
+            return false;
+        }
+        // Levels are visited in any order; read ahead only when asked to
+        madvise(memory, size, MADV_RANDOM);
+        data = static_cast<const uint8_t*>(memory);
+        if (!valid()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+
+    bool isOpen() const {
+        return data != nullptr;
+    }
+
+    std::string name() const {
+        return std::string(header().name, strnlen(header().name, LEVEL_NAME_SIZE));
+    }
+
+    size_t levelCount() const {
+        return header().levelCount;
+    }
+
+    const LevelPackEntry& entry(size_t index) const {
+        return reinterpret_cast<const LevelPackEntry*>(data + header().indexOffset)[index];
+    }
+
+    // View one level in place. Returns false if it is damaged.
+    bool level(size_t index, LevelView& view) const {
+        return view.attach(data + entry(index).offset, entry(index).size);
+    }
+
+    // Ask the kernel to start reading a level's pages in the background
+    void prefetch(size_t index) const {
+        const long page = sysconf(_SC_PAGESIZE);
+        uintptr_t begin = reinterpret_cast<uintptr_t>(data + entry(index).offset) / page * page;
+        uintptr_t end = reinterpret_cast<uintptr_t>(data + entry(index).offset + entry(index).size);
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+    }
+};
+
+// Writes a pack one level at a time, so building one never holds more than
+// a level and the index in memory
+class LevelPackWriter {
+private:
+    FILE* file = nullptr;
+    LevelPackHeader header;
+    std::vector<LevelPackEntry> index;
+    uint64_t offset = 0;
+
+    bool pad() {
+        static const char zeros[LEVEL_PACK_ALIGN] = {};
+        uint64_t gap = (LEVEL_PACK_ALIGN - offset % LEVEL_PACK_ALIGN) % LEVEL_PACK_ALIGN;
+        offset += gap;
+        return fwrite(zeros, 1, gap, file) == gap;
+    }
+
+public:
+    LevelPackWriter() = default;
+    LevelPackWriter(const LevelPackWriter&) = delete;
+    LevelPackWriter& operator=(const LevelPackWriter&) = delete;
+
+    ~LevelPackWriter() {
+        if (file) fclose(file);
+    }
+
+    // Start a pack file. Returns false if it cannot be created.
+    bool open(const char* path, const std::string& packName) {
+        file = fopen(path, "wb");
+        if (!file) return false;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, LEVEL_PACK_MAGIC, sizeof(header.magic));
+        header.version = LEVEL_PACK_VERSION;
+        header.headerSize = sizeof(LevelPackHeader);
+        header.entrySize = sizeof(LevelPackEntry);
+        strncpy(header.name, packName.c_str(), LEVEL_NAME_SIZE - 1);
+        index.clear();
+        offset = sizeof(header);
+        return fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    // Append a level. Returns false if it cannot be written.
+    bool add(const LevelSource& source) {
+        std::vector<uint8_t> bytes = encodeLevel(source);
+        LevelView level;
+        if (!file || !pad() || !level.attach(bytes.data(), bytes.size())) return false;
+        LevelPackEntry entry = describeLevel(level, source.difficulty);
+        entry.offset = offset;
+        entry.size = bytes.size();
+        if (fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) return false;
+        offset += bytes.size();
+        index.push_back(entry);
+        return true;
+    }
+
+    size_t levelCount() const {
+        return index.size();
+    }
+
+    // Write the index and close the file. Returns false if any of it
+    // failed to reach the disk.
+    bool finish() {
+        if (!file) return false;
+        bool written = pad();
+        header.indexOffset = offset;
+        header.levelCount = static_cast<uint32_t>(index.size());
+        header.fileSize = offset + index.size() * sizeof(LevelPackEntry);
+        written = written && fwrite(index.data(), sizeof(LevelPackEntry), index.size(), file) == index.size() &&
+                  fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+        written = fclose(file) == 0 && written;
+        file = nullptr;
+        return written;
+    }
+};
+
+#endif // BLOCKBREAKER_PACK_H
@@ -0,0 +1,151 @@
+// BlockBreaker - low-resolution pixel observations
+//
+// Rasterizes the playfield straight into a small 8-bit grayscale or RGB
+// buffer for pixel-based agents, without cairo. Everything is an axis-aligned
+// rectangle at this size (the ball included), filled with SSE2 row spans
+// (when simdLevel() allows) and a copy of the repeating color for the rest.
+// A pixel belongs to a shape when its center does, so output depends only on
+// the game state and is identical from run to run.
+
+#ifndef BLOCKBREAKER_PIXELOBS_H
+#define BLOCKBREAKER_PIXELOBS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "cpu.h"
+#include "game.h"
+
+const int PIXEL_OBS_SIZE = 84;
+
+struct PixelColor {
+    uint8_t r, g, b;
+
+    // ITU-R BT.601 luma, in integer math
+    uint8_t gray() const {
+        return static_cast<uint8_t>((r * 77 + g * 150 + b * 29 + 128) >> 8);
+    }
+};
+
+const PixelColor OBS_BACKGROUND = {26, 26, 51};
+const PixelColor OBS_PADDLE = {26, 153, 230};
+const PixelColor OBS_BALL = {255, 204, 0};
+
+inline void fillSpanGray(uint8_t* dst, int count, uint8_t value) {
+    int i = 0;
+#ifdef BLOCKBREAKER_X86
+    if (simdLevel() >= SimdLevel::Sse2) {
+        __m128i v = _mm_set1_epi8(static_cast<char>(value));
+        for (; i + 16 <= count; i += 16) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+        }
+    }
+#endif
+    memset(dst + i, value, count - i);
+}
+
+// Sixteen RGB pixels of one color: 48 bytes, three vectors' worth
+struct RgbPattern {
+    alignas(16) uint8_t bytes[48];
+
+    explicit RgbPattern(PixelColor color) {
+        for (int p = 0; p < 16; p++) {
+            bytes[p * 3] = color.r;
+            bytes[p * 3 + 1] = color.g;
+            bytes[p * 3 + 2] = color.b;
+        }
+    }
+};
+
+inline void fillSpanRgb(uint8_t* dst, int count, const RgbPattern& pattern) {
+    int i = 0;
+#ifdef BLOCKBREAKER_X86
+    if (simdLevel() >= SimdLevel::Sse2) {
+        __m128i v0 = _mm_load_si128(reinterpret_cast<const __m128i*>(pattern.bytes));
+        __m128i v1 = _mm_load_si128(reinterpret_cast<const __m128i*>(pattern.bytes + 16));
+        __m128i v2 = _mm_load_si128(reinterpret_cast<const __m128i*>(pattern.bytes + 32));
+        for (; i + 16 <= count; i += 16) {
+            uint8_t* out = dst + i * 3;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v0);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), v1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 32), v2);
+        }
+    }
+#endif
+    for (; i + 16 <= count; i += 16) memcpy(dst + i * 3, pattern.bytes, sizeof(pattern.bytes));
+    memcpy(dst + i * 3, pattern.bytes, (count - i) * 3);
+}
+
+// Renders game states into size x size buffers of 1 (gray) or 3 (RGB)
+// bytes per pixel, rows top to bottom
+class PixelObserver {
+private:
+    int size;
+    int channels;
+    double scaleX, scaleY;
+
+    // First pixel whose center is at or past the window coordinate
+    static int edge(double coordinate, double scale) {
+        return static_cast<int>(std::ceil(coordinate * scale - 0.5));
+    }
+
+    void fillRect(uint8_t* out, double x0, double y0, double x1, double y1, PixelColor color) const {
+        int px0 = std::max(0, edge(x0, scaleX)), px1 = std::min(size, edge(x1, scaleX));
+        int py0 = std::max(0, edge(y0, scaleY)), py1 = std::min(size, edge(y1, scaleY));
+        // Keep thin shapes visible: at least one pixel each way
+        if (px1 <= px0) px1 = std::min(size, px0 + 1);
+        if (py1 <= py0) py1 = std::min(size, py0 + 1);
+        if (px0 >= size || py0 >= size || px1 <= 0 || py1 <= 0) return;
+
+        if (channels == 1) {
+            uint8_t value = color.gray();
+            for (int y = py0; y < py1; y++) fillSpanGray(out + y * size + px0, px1 - px0, value);
+        } else {
+            RgbPattern pattern(color);
+            for (int y = py0; y < py1; y++) fillSpanRgb(out + (y * size + px0) * 3, px1 - px0, pattern);
+        }
+    }
+
+public:
+    explicit PixelObserver(int pixels = PIXEL_OBS_SIZE, int bytesPerPixel = 1)
+        : size(pixels), channels(bytesPerPixel == 3 ? 3 : 1),
+          scaleX(static_cast<double>(pixels) / WINDOW_WIDTH),
+          scaleY(static_cast<double>(pixels) / WINDOW_HEIGHT) {}
+
+    size_t bytes() const {
+        return static_cast<size_t>(size) * size * channels;
+    }
+
+    void render(const BlockBreakerGame& game, uint8_t* out) const {
+        if (channels == 1) {
+            fillSpanGray(out, size * size, OBS_BACKGROUND.gray());
+        } else {
+            fillSpanRgb(out, size * size, RgbPattern(OBS_BACKGROUND));
+        }
+
+        // Blocks can overlap at this size, so draw them in block order rather
+        // than roster order, which depends on the order they were destroyed
+        std::vector<uint32_t> drawOrder(game.standingBlocks().begin(), game.standingBlocks().end());
+        std::sort(drawOrder.begin(), drawOrder.end());
+        for (uint32_t index : drawOrder) {
+            const Block& block = game.getBlocks()[index];
+            PixelColor color = {static_cast<uint8_t>(block.r * 255), static_cast<uint8_t>(block.g * 255),
+                                static_cast<uint8_t>(block.b * 255)};
+            fillRect(out, block.x, block.y, block.x + block.width, block.y + block.height, color);
+        }
+
+        const Paddle& paddle = game.getPaddle();
+        fillRect(out, paddle.x - paddle.width / 2, paddle.y - paddle.height / 2,
+                 paddle.x + paddle.width / 2, paddle.y + paddle.height / 2, OBS_PADDLE);
+
+        for (const Ball& ball : game.getBalls()) {
+            fillRect(out, ball.x - ball.radius, ball.y - ball.radius,
+                     ball.x + ball.radius, ball.y + ball.radius, OBS_BALL);
+        }
+    }
+};
+
+#endif // BLOCKBREAKER_PIXELOBS_H
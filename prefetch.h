@@ -0,0 +1,120 @@
+// BlockBreaker - preparing the next level in the background
+//
+// LevelPrefetcher builds the level that comes next on a worker thread while
+// the current one is played: it reads the level's pages, builds its blocks
+// and broadphase grid and, in the GTK game, renders the block sprites the
+// first frame would otherwise render. Starting the level is then only a
+// swap of storage (BlockBreakerGame::startPrepared()), and the level it
+// replaces is freed on the worker too, so the transition fits in a frame
+// whatever the level's size.
+
+#ifndef BLOCKBREAKER_PREFETCH_H
+#define BLOCKBREAKER_PREFETCH_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "game.h"
+
+class LevelPrefetcher {
+public:
+    // Fills level, or returns false if it could not be built
+    typedef std::function<bool(PreparedLevel& level)> PrepareFunction;
+
+private:
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    PrepareFunction job;        // Not started yet
+    long requested = -1;        // Key of the level wanted next
+    long readyKey = -1;         // Key of the level in ready
+    bool readyFailed = false;   // Its prepare() returned false; ready is empty
+    PreparedLevel ready;
+    PreparedLevel spent;        // Replaced by the last start(), to free
+    bool hasSpent = false;
+    bool stopping = false;
+    std::thread worker;         // Last, so it starts with the rest in place
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || job || hasSpent; });
+            if (stopping) return;
+
+            PreparedLevel garbage, level;
+            std::swap(garbage, spent);
+            hasSpent = false;
+            PrepareFunction prepare;
+            std::swap(prepare, job);
+            long key = requested;
+            lock.unlock();
+            garbage = PreparedLevel();
+            bool built = prepare && prepare(level);
+            lock.lock();
+
+            if (prepare) {
+                if (!built) level = PreparedLevel();
+                std::swap(ready, level);
+                readyKey = key;
+                readyFailed = !built;
+                finished.notify_all();
+            }
+            // Free whatever level was ready before, if it was never started
+            lock.unlock();
+            level = PreparedLevel();
+            lock.lock();
+        }
+    }
+
+public:
+    LevelPrefetcher() : worker([this] { run(); }) {}
+    LevelPrefetcher(const LevelPrefetcher&) = delete;
+    LevelPrefetcher& operator=(const LevelPrefetcher&) = delete;
+
+    ~LevelPrefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    // Prepare the level called key with prepare() on the worker, unless it
+    // is the one already wanted. A new key replaces the previous request.
+    // prepare() must only read data that stays put meanwhile.
+    void request(long key, PrepareFunction prepare) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (key == requested) return;
+            requested = key;
+            job = std::move(prepare);
+        }
+        wake.notify_all();
+    }
+
+    // Start the game on the level called key, waiting for the worker if it
+    // is not done yet. Returns false, changing nothing in the game, if key is
+    // not the level last requested or could not be prepared; the caller then
+    // loads it itself.
+    bool start(long key, BlockBreakerGame& game) {
+        bool built;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (key != requested) return false;
+            finished.wait(lock, [&] { return readyKey == key; });
+            built = !readyFailed;
+            if (built) game.startPrepared(ready);
+            std::swap(spent, ready);
+            hasSpent = true;
+            readyKey = requested = -1;
+            readyFailed = false;
+        }
+        wake.notify_all();
+        return built;
+    }
+};
+
+#endif // BLOCKBREAKER_PREFETCH_H
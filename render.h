@@ -0,0 +1,505 @@
+// BlockBreaker - rendering support shared by the game objects
+//
+// Quality tiers, the frame-budget governor that picks between them, the
+// batched draw list used for the block field, its pixel-aligned rectangle
+// fast path, and sprite rendering for the blitter.
+
+#ifndef BLOCKBREAKER_RENDER_H
+#define BLOCKBREAKER_RENDER_H
+
+#include <cairo.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "blit.h"
+
+// Rendering quality tiers, best first. Each tier drops the most expensive
+// remaining effect of the one above it.
+enum class Quality {
+    Full,       // Gradients, highlight/shadow strokes and inner bevels
+    Bevel,      // Solid fills with highlight/shadow strokes and bevels
+    Flat,       // Solid fills only
+    FlatNoAA    // Solid fills with antialiasing disabled
+};
+
+const int QUALITY_TIER_COUNT = 4;
+
+// Chooses a quality tier from measured frame times.
+//
+// Frame cost is smoothed with an exponential moving average. The governor
+// drops a tier quickly once the average runs over budget and only climbs back
+// after a long stretch well under budget. The gap between the two thresholds
+// plus the asymmetric hold times keep it from oscillating; if a tier it just
+// upgraded to immediately proves too slow, the upgrade hold doubles.
+class QualityGovernor {
+private:
+    double budgetMs;
+    double averageMs;
+    int tier;
+    int framesOver;
+    int framesUnder;
+    int upgradeHold;
+    int framesSinceUpgrade;
+
+    static const int DOWNGRADE_HOLD = 10;       // ~1/6 s at 60 fps
+    static const int MIN_UPGRADE_HOLD = 120;    // ~2 s at 60 fps
+    static const int MAX_UPGRADE_HOLD = 1920;   // ~32 s at 60 fps
+    static constexpr double SMOOTHING = 0.1;
+    static constexpr double DOWNGRADE_RATIO = 0.75;  // of the budget
+    static constexpr double UPGRADE_RATIO = 0.35;
+
+public:
+    // budget is the time we allow our own work (update + draw) per frame
+    explicit QualityGovernor(double budget = 1000.0 / 60.0 * 0.5)
+        : budgetMs(budget), averageMs(0), tier(0), framesOver(0), framesUnder(0),
+          upgradeHold(MIN_UPGRADE_HOLD), framesSinceUpgrade(MAX_UPGRADE_HOLD) {}
+
+    void recordFrame(double frameMs) {
+        averageMs = averageMs == 0 ? frameMs : averageMs + SMOOTHING * (frameMs - averageMs);
+        framesSinceUpgrade++;
+
+        if (averageMs > budgetMs * DOWNGRADE_RATIO) {
+            framesUnder = 0;
+            if (++framesOver >= DOWNGRADE_HOLD && tier < QUALITY_TIER_COUNT - 1) {
+                // An upgrade that could not hold its frame rate: wait longer next time
+                if (framesSinceUpgrade < upgradeHold) {
+                    upgradeHold = upgradeHold * 2 > MAX_UPGRADE_HOLD ? MAX_UPGRADE_HOLD : upgradeHold * 2;
+                }
+                tier++;
+                framesOver = 0;
+                averageMs = 0;  // Re-measure from scratch at the new tier
+            }
+        } else if (averageMs < budgetMs * UPGRADE_RATIO) {
+            framesOver = 0;
+            if (++framesUnder >= upgradeHold && tier > 0) {
+                tier--;
+                framesUnder = 0;
+                framesSinceUpgrade = 0;
+                averageMs = 0;
+            }
+        } else {
+            framesOver = 0;
+            framesUnder = 0;
+        }
+    }
+
+    Quality quality() const {
+        return static_cast<Quality>(tier);
+    }
+
+    double averageFrameMs() const {
+        return averageMs;
+    }
+};
+
+// An ARGB32/RGB24 image surface we may write pixels into directly, with the
+// user-to-pixel translation and the (single-rectangle) clip in pixels.
+struct PixelTarget {
+    uint32_t* data;
+    int stride;                 // In pixels
+    int originX, originY;       // Pixel position of user-space (0, 0)
+    int clipX0, clipY0, clipX1, clipY1;
+    
+    // Succeeds only when user space maps onto whole pixels and the clip is a
+    // single pixel-aligned rectangle, so direct writes land exactly where
+    // cairo would draw.
+    bool acquire(cairo_t* cr) {
+        cairo_surface_t* surface = cairo_get_group_target(cr);
+        if (cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE) return false;
+        cairo_format_t format = cairo_image_surface_get_format(surface);
+        if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24) return false;
+        
+        cairo_matrix_t m;
+        cairo_get_matrix(cr, &m);
+        double offsetX, offsetY;
+        cairo_surface_get_device_offset(surface, &offsetX, &offsetY);
+        if (m.xx != 1 || m.yy != 1 || m.xy != 0 || m.yx != 0) return false;
+        if (!isWhole(m.x0 + offsetX) || !isWhole(m.y0 + offsetY)) return false;
+        originX = static_cast<int>(m.x0 + offsetX);
+        originY = static_cast<int>(m.y0 + offsetY);
+        
+        cairo_rectangle_list_t* clip = cairo_copy_clip_rectangle_list(cr);
+        bool simpleClip = clip->status == CAIRO_STATUS_SUCCESS && clip->num_rectangles == 1;
+        if (simpleClip) {
+            const cairo_rectangle_t& rect = clip->rectangles[0];
+            simpleClip = isWhole(rect.x) && isWhole(rect.y) && isWhole(rect.width) && isWhole(rect.height);
+            clipX0 = std::max(0, originX + static_cast<int>(rect.x));
+            clipY0 = std::max(0, originY + static_cast<int>(rect.y));
+            clipX1 = std::min(cairo_image_surface_get_width(surface), originX + static_cast<int>(rect.x + rect.width));
+            clipY1 = std::min(cairo_image_surface_get_height(surface), originY + static_cast<int>(rect.y + rect.height));
+        }
+        cairo_rectangle_list_destroy(clip);
+        if (!simpleClip) return false;
+        
+        cairo_surface_flush(surface);
+        data = reinterpret_cast<uint32_t*>(cairo_image_surface_get_data(surface));
+        stride = cairo_image_surface_get_stride(surface) / 4;
+        return data != nullptr;
+    }
+    
+    static bool isWhole(double v) {
+        return v == std::floor(v);
+    }
+    
+    // Premultiplied pixel for a solid source, converted the way cairo and
+    // pixman do it: doubles to 16-bit premultiplied, then the high byte.
+    static uint32_t solidPixel(double r, double g, double b, double a) {
+        auto clamp = [](double v) { return v < 0 ? 0.0 : (v > 1 ? 1.0 : v); };
+        auto toShort = [](double v) { return static_cast<uint32_t>(v * 65535.0 + 0.5); };
+        a = clamp(a);
+        return ((toShort(a) >> 8) << 24) | ((toShort(clamp(r) * a) >> 8) << 16) |
+               ((toShort(clamp(g) * a) >> 8) << 8) | (toShort(clamp(b) * a) >> 8);
+    }
+    
+    // Composite a sprite OVER the surface with its top-left at user (x, y)
+    void blit(const Sprite& sprite, int x, int y) const {
+        blitSprite(data, stride, clipX0, clipY0, clipX1, clipY1, sprite, x + originX, y + originY);
+    }
+    
+    // Composite a solid premultiplied pixel OVER the user-space rectangle
+    // [x0, x1) x [y0, y1), rounding like pixman's combine_over.
+    void fillRect(int x0, int y0, int x1, int y1, uint32_t pixel) const {
+        x0 = std::max(x0 + originX, clipX0);
+        y0 = std::max(y0 + originY, clipY0);
+        x1 = std::min(x1 + originX, clipX1);
+        y1 = std::min(y1 + originY, clipY1);
+        if (x0 >= x1 || y0 >= y1) return;
+        
+        uint32_t inverseAlpha = 255 - (pixel >> 24);
+        for (int y = y0; y < y1; y++) {
+            uint32_t* row = data + static_cast<size_t>(y) * stride;
+            if (inverseAlpha == 0) {
+                std::fill(row + x0, row + x1, pixel);
+                continue;
+            }
+            for (int x = x0; x < x1; x++) {
+                uint32_t d = row[x];
+                uint32_t rb = (d & 0x00ff00ff) * inverseAlpha + 0x00800080;
+                rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+                uint32_t ag = ((d >> 8) & 0x00ff00ff) * inverseAlpha + 0x00800080;
+                ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+                row[x] = (rb | ag) + pixel;  // Premultiplied, so this cannot carry
+            }
+        }
+    }
+};
+
+// Drawing layers for the block field, back to front
+enum class DrawLayer : uint8_t {
+    Body,
+    Highlight,
+    Shadow,
+    Bevel
+};
+
+enum class DrawOp : uint8_t {
+    Fill,           // Solid fill of a rectangle
+    GradientFill,   // Corner-to-corner linear gradient fill of a rectangle
+    StrokeRect,     // Stroke of a closed rectangle outline
+    StrokeCorner    // Stroke of the bottom/right edges of a rectangle
+};
+
+struct DrawCommand {
+    DrawLayer layer;
+    DrawOp op;
+    double x, y, width, height;
+    double r, g, b, a;          // Solid color, or the gradient's start color
+    double r2, g2, b2;          // Gradient end color
+    double lineWidth;
+};
+
+// Cairo work issued by one DrawList::flush()
+struct DrawStats {
+    int commands = 0;
+    int sourceChanges = 0;   // cairo_set_source*() calls
+    int paints = 0;          // cairo_fill() / cairo_stroke() calls
+    int pixelCommands = 0;   // Commands written straight into the image surface
+    int spriteBlits = 0;     // Pre-rendered sprites composited by the blitter
+};
+
+// Per-frame command list for the block field.
+//
+// Objects record their fills and strokes here instead of talking to cairo
+// directly. flush() either replays the list in recording order, or groups
+// commands by layer and style so that every run of identical style becomes a
+// single path with one source change and one fill or stroke.
+//
+// Grouping reorders commands across objects (all bodies, then all
+// highlights, ...), which is only correct while the recorded objects,
+// including the 1px stroke overhang, do not overlap. Block layouts keep at
+// least 2px of spacing for that reason.
+//
+// With the fast path enabled, commands whose geometry sits on whole pixels
+// skip cairo's antialiasing rasterizer: solid ones are composited straight
+// into image surfaces, the rest are drawn with CAIRO_ANTIALIAS_NONE. Both give
+// the same pixels as the antialiased path, since every edge covers whole
+// pixels.
+class DrawList {
+private:
+    std::vector<DrawCommand> commands;
+    std::vector<uint32_t> order;
+    bool fastRects = true;
+    
+    // Pixel-aligned once the user-space translation is whole, which
+    // PixelTarget::acquire() or flush() checks
+    static bool pixelAligned(const DrawCommand& c) {
+        bool aligned = PixelTarget::isWhole(c.x) && PixelTarget::isWhole(c.y) &&
+                       PixelTarget::isWhole(c.width) && PixelTarget::isWhole(c.height) &&
+                       c.width >= 0 && c.height >= 0;
+        if (c.op == DrawOp::StrokeRect || c.op == DrawOp::StrokeCorner) {
+            aligned = aligned && PixelTarget::isWhole(c.lineWidth / 2);
+        }
+        return aligned;
+    }
+    
+    // Write a pixel-aligned solid command as disjoint rectangles, so
+    // translucent strokes are not blended twice where segments meet
+    static void writePixels(const PixelTarget& target, const DrawCommand& c) {
+        uint32_t pixel = PixelTarget::solidPixel(c.r, c.g, c.b, c.a);
+        int x0 = static_cast<int>(c.x), y0 = static_cast<int>(c.y);
+        int x1 = x0 + static_cast<int>(c.width), y1 = y0 + static_cast<int>(c.height);
+        int hw = static_cast<int>(c.lineWidth / 2);
+        
+        switch (c.op) {
+            case DrawOp::Fill:
+                target.fillRect(x0, y0, x1, y1, pixel);
+                break;
+            case DrawOp::StrokeRect: {
+                // Miter joins square off the corners; the top and bottom bands
+                // take them, the sides fill in between
+                int bottom = std::max(y1 - hw, y0 + hw);
+                target.fillRect(x0 - hw, y0 - hw, x1 + hw, y0 + hw, pixel);
+                target.fillRect(x0 - hw, bottom, x1 + hw, y1 + hw, pixel);
+                int right = std::max(x1 - hw, x0 + hw);
+                target.fillRect(x0 - hw, y0 + hw, x0 + hw, bottom, pixel);
+                target.fillRect(right, y0 + hw, x1 + hw, bottom, pixel);
+                break;
+            }
+            case DrawOp::StrokeCorner:
+                // Butt caps at both ends, a mitered join at the bottom right
+                target.fillRect(x1 - hw, y0, x1 + hw, y1 + hw, pixel);
+                target.fillRect(x0, y1 - hw, x1 - hw, y1 + hw, pixel);
+                break;
+            case DrawOp::GradientFill:
+                break;
+        }
+    }
+
+    static bool sameStyle(const DrawCommand& a, const DrawCommand& b) {
+        return a.layer == b.layer && a.op == b.op && a.op != DrawOp::GradientFill &&
+               a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a &&
+               a.lineWidth == b.lineWidth;
+    }
+
+    static bool styleLess(const DrawCommand& a, const DrawCommand& b) {
+        if (a.layer != b.layer) return a.layer < b.layer;
+        if (a.op != b.op) return a.op < b.op;
+        if (a.r != b.r) return a.r < b.r;
+        if (a.g != b.g) return a.g < b.g;
+        if (a.b != b.b) return a.b < b.b;
+        if (a.a != b.a) return a.a < b.a;
+        return a.lineWidth < b.lineWidth;
+    }
+
+    static void setSource(cairo_t* cr, const DrawCommand& c, DrawStats& stats) {
+        stats.sourceChanges++;
+        if (c.op == DrawOp::GradientFill) {
+            cairo_pattern_t *gradient = cairo_pattern_create_linear(c.x, c.y, c.x + c.width, c.y + c.height);
+            cairo_pattern_add_color_stop_rgb(gradient, 0.0, c.r, c.g, c.b);
+            cairo_pattern_add_color_stop_rgb(gradient, 1.0, c.r2, c.g2, c.b2);
+            cairo_set_source(cr, gradient);
+            cairo_pattern_destroy(gradient);
+        } else {
+            cairo_set_source_rgba(cr, c.r, c.g, c.b, c.a);
+        }
+    }
+
+    static void addPath(cairo_t* cr, const DrawCommand& c) {
+        if (c.op == DrawOp::StrokeCorner) {
+            cairo_move_to(cr, c.x + c.width, c.y);
+            cairo_line_to(cr, c.x + c.width, c.y + c.height);
+            cairo_line_to(cr, c.x, c.y + c.height);
+        } else {
+            cairo_rectangle(cr, c.x, c.y, c.width, c.height);
+        }
+    }
+
+    static void paint(cairo_t* cr, const DrawCommand& c, DrawStats& stats) {
+        stats.paints++;
+        if (c.op == DrawOp::StrokeRect || c.op == DrawOp::StrokeCorner) {
+            cairo_set_line_width(cr, c.lineWidth);
+            cairo_stroke(cr);
+        } else {
+            cairo_fill(cr);
+        }
+    }
+
+public:
+    void clear() {
+        commands.clear();
+    }
+
+    size_t size() const {
+        return commands.size();
+    }
+
+    void fill(DrawLayer layer, double x, double y, double w, double h,
+              double r, double g, double b, double a = 1.0) {
+        commands.push_back({layer, DrawOp::Fill, x, y, w, h, r, g, b, a, 0, 0, 0, 0});
+    }
+
+    void gradientFill(DrawLayer layer, double x, double y, double w, double h,
+                      double r, double g, double b, double r2, double g2, double b2) {
+        commands.push_back({layer, DrawOp::GradientFill, x, y, w, h, r, g, b, 1.0, r2, g2, b2, 0});
+    }
+
+    void strokeRect(DrawLayer layer, double x, double y, double w, double h, double lineWidth,
+                    double r, double g, double b, double a) {
+        commands.push_back({layer, DrawOp::StrokeRect, x, y, w, h, r, g, b, a, 0, 0, 0, lineWidth});
+    }
+
+    void strokeCorner(DrawLayer layer, double x, double y, double w, double h, double lineWidth,
+                      double r, double g, double b, double a) {
+        commands.push_back({layer, DrawOp::StrokeCorner, x, y, w, h, r, g, b, a, 0, 0, 0, lineWidth});
+    }
+
+    void setFastRects(bool enabled) {
+        fastRects = enabled;
+    }
+    
+    // Submit the recorded commands to cairo
+    DrawStats flush(cairo_t* cr, bool batched) {
+        DrawStats stats;
+        stats.commands = static_cast<int>(commands.size());
+        cairo_new_path(cr);
+        
+        order.resize(commands.size());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        if (batched) {
+            std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+                return styleLess(commands[a], commands[b]);
+            });
+        }
+        
+        cairo_matrix_t m;
+        cairo_get_matrix(cr, &m);
+        bool wholeTranslation = m.xx == 1 && m.yy == 1 && m.xy == 0 && m.yx == 0 &&
+                                PixelTarget::isWhole(m.x0) && PixelTarget::isWhole(m.y0);
+        PixelTarget target;
+        bool usePixels = fastRects && target.acquire(cr);
+        bool pixelsDirty = false;
+        cairo_antialias_t antialias = cairo_get_antialias(cr);
+        
+        size_t i = 0;
+        while (i < order.size()) {
+            // A group is a run of one style, or a single command when not batching
+            const DrawCommand& first = commands[order[i]];
+            size_t end = i + 1;
+            while (batched && end < order.size() && sameStyle(first, commands[order[end]])) {
+                end++;
+            }
+            
+            bool cairoPath = false;
+            bool allAligned = true;
+            for (size_t j = i; j < end; j++) {
+                const DrawCommand& c = commands[order[j]];
+                bool aligned = fastRects && wholeTranslation && pixelAligned(c);
+                if (aligned && usePixels && c.op != DrawOp::GradientFill) {
+                    writePixels(target, c);
+                    pixelsDirty = true;
+                    stats.pixelCommands++;
+                    continue;
+                }
+                allAligned = allAligned && aligned;
+                cairoPath = true;
+                addPath(cr, c);
+            }
+            
+            if (cairoPath) {
+                if (pixelsDirty) {
+                    cairo_surface_mark_dirty(cairo_get_group_target(cr));
+                    pixelsDirty = false;
+                }
+                cairo_set_antialias(cr, allAligned ? CAIRO_ANTIALIAS_NONE : antialias);
+                setSource(cr, first, stats);
+                paint(cr, first, stats);
+                if (usePixels) cairo_surface_flush(cairo_get_group_target(cr));
+            }
+            i = end;
+        }
+        
+        if (pixelsDirty) {
+            cairo_surface_mark_dirty(cairo_get_group_target(cr));
+        }
+        cairo_set_antialias(cr, antialias);
+        return stats;
+    }
+};
+
+// Render into a new transparent sprite. draw() gets a context translated so
+// that user-space (left, top) is the sprite's top-left pixel.
+template <typename DrawFunction>
+Sprite renderSprite(int width, int height, double left, double top, DrawFunction draw) {
+    Sprite sprite(width, height);
+    cairo_surface_t* surface = cairo_image_surface_create_for_data(
+        reinterpret_cast<unsigned char*>(sprite.pixels.data()), CAIRO_FORMAT_ARGB32,
+        width, height, width * 4);
+    cairo_t* cr = cairo_create(surface);
+    cairo_translate(cr, -left, -top);
+    draw(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+    cairo_surface_destroy(surface);
+    return sprite;
+}
+
+const int SUBPIXEL_PHASES = 4;  // Per axis
+
+// A moving object pre-rendered at SUBPIXEL_PHASES x SUBPIXEL_PHASES subpixel
+// offsets. Blitting the nearest phase at the integer position keeps motion
+// smooth without rasterizing the object again every frame.
+class PhaseSpriteCache {
+private:
+    Sprite phases[SUBPIXEL_PHASES * SUBPIXEL_PHASES];
+    int halfExtent = 0;     // Pixels from the sprite's top-left to the phase-0 center
+    
+public:
+    bool empty() const {
+        return phases[0].empty();
+    }
+    
+    void clear() {
+        for (auto& sprite : phases) sprite = Sprite();
+    }
+    
+    // drawAt(cr, x, y) draws the object centered at (x, y). halfExtent must
+    // cover its radius plus any antialiasing fringe.
+    template <typename DrawFunction>
+    void build(int extent, DrawFunction drawAt) {
+        halfExtent = extent;
+        int size = 2 * extent + 1;  // One extra pixel for the largest phase offset
+        for (int py = 0; py < SUBPIXEL_PHASES; py++) {
+            for (int px = 0; px < SUBPIXEL_PHASES; px++) {
+                phases[py * SUBPIXEL_PHASES + px] = renderSprite(size, size, 0, 0, [&](cairo_t* cr) {
+                    drawAt(cr, extent + static_cast<double>(px) / SUBPIXEL_PHASES,
+                               extent + static_cast<double>(py) / SUBPIXEL_PHASES);
+                });
+            }
+        }
+    }
+    
+    // Composite the phase nearest to a center at (x, y)
+    void blit(const PixelTarget& target, double x, double y) const {
+        double baseX = std::floor(x), baseY = std::floor(y);
+        int ix = static_cast<int>(baseX), iy = static_cast<int>(baseY);
+        int px = static_cast<int>(std::lround((x - baseX) * SUBPIXEL_PHASES));
+        int py = static_cast<int>(std::lround((y - baseY) * SUBPIXEL_PHASES));
+        if (px == SUBPIXEL_PHASES) { px = 0; ix++; }
+        if (py == SUBPIXEL_PHASES) { py = 0; iy++; }
+        target.blit(phases[py * SUBPIXEL_PHASES + px], ix - halfExtent, iy - halfExtent);
+    }
+};
+
+#endif // BLOCKBREAKER_RENDER_H
@@ -0,0 +1,133 @@
+// BlockBreaker - live game state in POSIX shared memory
+//
+// StatePublisher copies the game state into a named shared-memory segment
+// once per tick so visualizers, trainers and telemetry can follow a running
+// game without talking to it. The segment holds one SharedGameState guarded
+// by a seqlock: the writer makes the sequence odd, writes, and makes it even
+// again; readers copy the state out and retry if the sequence was odd or
+// changed meanwhile. Neither side makes a system call per frame, and readers
+// never hold up the game.
+
+#ifndef BLOCKBREAKER_SHM_H
+#define BLOCKBREAKER_SHM_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "game.h"
+
+const uint32_t SHARED_STATE_MAGIC = 0x42424753;  // "SGBB" in memory
+const uint32_t SHARED_STATE_VERSION = 2;
+
+// What a reader gets: the tick count and the game's snapshot, which carries
+// the balls, paddle, score, lives and active-block bitset. A snapshot holds
+// at most SNAPSHOT_MAX_BALLS balls and SNAPSHOT_MAX_BLOCKS blocks; beyond
+// that only the first ones are published, truncated is set, and the totals
+// give the game's real counts.
+struct SharedGamePayload {
+    uint64_t tick;
+    uint32_t totalBalls, totalBlocks;
+    uint32_t truncated;                 // Nonzero when game holds fewer balls or blocks than that
+    GameSnapshot game;
+};
+
+struct SharedGameState {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t payloadSize;               // sizeof(SharedGamePayload), for layout checks
+    std::atomic<uint32_t> sequence;     // Odd while an update is in progress
+    SharedGamePayload payload;
+};
+
+static_assert(std::is_trivially_copyable<SharedGamePayload>::value, "payload is copied as raw bytes");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "sequence must work across processes");
+
+// Copy a consistent payload out of a mapped segment, spinning past updates
+inline void readSharedState(const SharedGameState* state, SharedGamePayload& out) {
+    for (;;) {
+        uint32_t before = state->sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        memcpy(&out, &state->payload, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (state->sequence.load(std::memory_order_relaxed) == before) return;
+    }
+}
+
+class StatePublisher {
+private:
+    std::string name;
+    SharedGameState* state = nullptr;
+    SharedGamePayload staging = {};
+
+public:
+    StatePublisher() = default;
+    StatePublisher(const StatePublisher&) = delete;
+    StatePublisher& operator=(const StatePublisher&) = delete;
+
+    ~StatePublisher() {
+        close();
+    }
+
+    // Create (or take over) the segment, e.g. "/blockbreaker". Returns false
+    // if it cannot be created or mapped.
+    bool open(const char* segmentName) {
+        close();
+        int fd = shm_open(segmentName, O_CREAT | O_RDWR, 0644);
+        if (fd < 0) return false;
+        bool sized = ftruncate(fd, sizeof(SharedGameState)) == 0;
+        void* memory = sized ? mmap(nullptr, sizeof(SharedGameState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                             : MAP_FAILED;
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            shm_unlink(segmentName);
+            return false;
+        }
+
+        name = segmentName;
+        state = static_cast<SharedGameState*>(memory);
+        state->sequence.store(0, std::memory_order_relaxed);
+        state->magic = SHARED_STATE_MAGIC;
+        state->version = SHARED_STATE_VERSION;
+        state->payloadSize = sizeof(SharedGamePayload);
+        memset(&state->payload, 0, sizeof(state->payload));
+        return true;
+    }
+
+    // Unmap and remove the segment
+    void close() {
+        if (!state) return;
+        munmap(state, sizeof(SharedGameState));
+        shm_unlink(name.c_str());
+        state = nullptr;
+    }
+
+    bool isOpen() const {
+        return state != nullptr;
+    }
+
+    // Publish the game's state as of the given tick, cut down to what a
+    // snapshot holds if need be
+    void publish(const BlockBreakerGame& game, uint64_t tick) {
+        if (!state) return;
+        staging.tick = tick;
+        staging.totalBalls = static_cast<uint32_t>(game.ballCount());
+        staging.totalBlocks = static_cast<uint32_t>(game.getBlocks().size());
+        staging.truncated = !game.saveTruncated(staging.game);
+
+        uint32_t sequence = state->sequence.load(std::memory_order_relaxed);
+        state->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&state->payload, &staging, sizeof(staging));
+        state->sequence.store(sequence + 2, std::memory_order_release);
+    }
+};
+
+#endif // BLOCKBREAKER_SHM_H
@@ -0,0 +1,138 @@
+// BlockBreaker - fixed pool of worker threads for parallel loops
+//
+// run(count, job) calls job(index) for every index in [0, count), spread over
+// the workers and the calling thread, and returns once all calls are done.
+// Scheduling is work stealing: each thread starts on its own contiguous share
+// of the indices, taking them from the front, and a thread that runs dry takes
+// the back half of another thread's share. Uneven jobs still balance, and
+// threads only touch shared state when they steal.
+
+#ifndef BLOCKBREAKER_THREADPOOL_H
+#define BLOCKBREAKER_THREADPOOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+private:
+    // A thread's remaining indices, [begin, end)
+    struct alignas(64) Share {
+        std::mutex lock;
+        size_t begin = 0, end = 0;
+    };
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<Share[]> shares;    // One per thread; the caller's is 0
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const std::function<void(size_t)>* job = nullptr;
+    size_t busy = 0;            // Workers still on the current job
+    uint64_t generation = 0;    // Bumped for every job
+    bool stopping = false;
+
+    // Next index for thread self: its own front, else half of a victim's back
+    bool take(unsigned self, size_t& index) {
+        Share& own = shares[self];
+        {
+            std::lock_guard<std::mutex> lock(own.lock);
+            if (own.begin < own.end) {
+                index = own.begin++;
+                return true;
+            }
+        }
+
+        unsigned count = size();
+        for (unsigned k = 1; k < count; k++) {
+            Share& victim = shares[(self + k) % count];
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(victim.lock);
+                size_t left = victim.end - victim.begin;
+                if (left == 0) continue;
+                end = victim.end;
+                begin = end - (left + 1) / 2;
+                victim.end = begin;
+            }
+            std::lock_guard<std::mutex> lock(own.lock);
+            own.begin = begin + 1;
+            own.end = end;
+            index = begin;
+            return true;
+        }
+        return false;
+    }
+
+    void drain(unsigned self) {
+        for (size_t index; take(self, index);) {
+            (*job)(index);
+        }
+    }
+
+    void workerLoop(unsigned self) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            lock.unlock();
+            drain(self);
+            lock.lock();
+            if (--busy == 0) done.notify_one();
+        }
+    }
+
+public:
+    // threads counts the calling thread, so a pool of 1 runs jobs inline
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency())
+        : shares(new Share[std::max(1u, threads)]) {
+        for (unsigned i = 1; i < threads; i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    void run(size_t count, const std::function<void(size_t)>& fn) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            unsigned threads = size();
+            for (unsigned i = 0; i < threads; i++) {
+                std::lock_guard<std::mutex> shareLock(shares[i].lock);
+                shares[i].begin = count * i / threads;
+                shares[i].end = count * (i + 1) / threads;
+            }
+            busy = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        drain(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy == 0; });
+        job = nullptr;
+    }
+};
+
+#endif // BLOCKBREAKER_THREADPOOL_H
@@ -0,0 +1,185 @@
+// BlockBreaker - parallel tournament of headless games
+//
+// Plays every combination of level, seed and paddle policy on a work-stealing
+// thread pool. Each game depends only on its own level, seed and policy, and
+// results are stored and summed in a fixed order, so everything except wall
+// time comes out the same whatever the thread count.
+
+#ifndef BLOCKBREAKER_TOURNAMENT_H
+#define BLOCKBREAKER_TOURNAMENT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "game.h"
+#include "ai.h"
+#include "cycle.h"
+#include "pack.h"
+#include "threadpool.h"
+
+enum class Policy {
+    Follow,     // Paddle under the ball
+    Landing,    // LandingBot
+    Mcts        // MctsPlayer, single-threaded with a fixed iteration budget
+};
+
+inline const char* policyName(Policy policy) {
+    switch (policy) {
+        case Policy::Follow: return "follow";
+        case Policy::Landing: return "landing";
+        case Policy::Mcts: return "mcts";
+    }
+    return "?";
+}
+
+inline bool parsePolicy(const std::string& name, Policy& policy) {
+    for (Policy p : {Policy::Follow, Policy::Landing, Policy::Mcts}) {
+        if (name == policyName(p)) {
+            policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct TournamentLevel {
+    int rows, cols;
+    int pack = -1;      // Level in config.pack to play instead, if not -1
+};
+
+struct TournamentConfig {
+    std::vector<TournamentLevel> levels;
+    const LevelPack* pack = nullptr;
+    std::vector<uint64_t> seeds;
+    std::vector<Policy> policies;
+    long maxTicks = 100000;
+    uint64_t mctsIterations = 64;   // Per tick
+    StuckAction stuck = StuckAction::Perturb;
+    unsigned threads = std::thread::hardware_concurrency();
+};
+
+struct GameResult {
+    int level;          // Indices into the config
+    int seed;
+    int policy;
+    int score;
+    long ticks;
+    int livesLost;
+    bool won;
+    uint64_t loops;     // Bounce loops detected
+    double wallSeconds;
+};
+
+// Totals for one level and policy over all seeds
+struct PolicySummary {
+    int level, policy;
+    int games = 0, wins = 0, stuckGames = 0;
+    long long score = 0, ticks = 0, livesLost = 0;
+    double wallSeconds = 0;
+};
+
+// "ROWSxCOLS", or "pack:INDEX" for a level from the pack
+inline std::string levelLabel(const TournamentConfig& config, int level) {
+    const TournamentLevel& layout = config.levels[level];
+    if (layout.pack >= 0) return "pack:" + std::to_string(layout.pack);
+    return std::to_string(layout.rows) + "x" + std::to_string(layout.cols);
+}
+
+inline GameResult playTournamentGame(const TournamentConfig& config, int level, int seed, int policy) {
+    auto start = std::chrono::steady_clock::now();
+    BlockBreakerGame game(config.seeds[seed]);
+    const TournamentLevel& layout = config.levels[level];
+    LevelView packLevel;
+    bool playable = true;
+    if (layout.pack >= 0) {
+        // Only this game's level is read from the pack. A damaged one is
+        // not played and counts as lost.
+        playable = config.pack && config.pack->level(layout.pack, packLevel);
+        if (playable) loadLevel(game, packLevel);
+    } else if (layout.rows != BLOCK_ROWS || layout.cols != BLOCK_COLS) {
+        game.resetGame(layout.rows, layout.cols);
+    }
+    int startLives = game.getLives();
+
+    LandingBot bot;
+    CycleDetector detector;
+    std::unique_ptr<MctsPlayer> mcts;
+    if (config.policies[policy] == Policy::Mcts) mcts = std::make_unique<MctsPlayer>(1);
+
+    long tick = 0;
+    game.start();
+    while (playable && !game.isGameOver() && tick < config.maxTicks) {
+        switch (config.policies[policy]) {
+            case Policy::Follow:
+                game.movePaddle(game.getBalls().front().x);
+                break;
+            case Policy::Landing:
+                game.movePaddle(bot.target(game));
+                break;
+            case Policy::Mcts:
+                game.movePaddle(mcts->decide(game, 0, config.mctsIterations));
+                break;
+        }
+        game.update();
+        if (!game.isGameRunning() && !game.isGameOver()) {
+            game.start();  // Serve again straight away after a lost life
+        }
+        tick++;
+        if (!checkStuck(detector, game, config.stuck)) break;
+    }
+
+    GameResult result;
+    result.level = level;
+    result.seed = seed;
+    result.policy = policy;
+    result.score = game.getScore();
+    result.ticks = tick;
+    result.livesLost = startLives - game.getLives();
+    result.won = playable && game.isGameOver() && game.getLives() > 0;
+    result.loops = detector.detections();
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Play every level x seed x policy game. Results come back ordered by level,
+// then policy, then seed.
+inline std::vector<GameResult> runTournament(const TournamentConfig& config) {
+    int seeds = static_cast<int>(config.seeds.size());
+    int policies = static_cast<int>(config.policies.size());
+    std::vector<GameResult> results(config.levels.size() * seeds * policies);
+
+    ThreadPool pool(std::max(1u, config.threads));
+    pool.run(results.size(), [&](size_t index) {
+        int seed = static_cast<int>(index % seeds);
+        int policy = static_cast<int>(index / seeds % policies);
+        int level = static_cast<int>(index / seeds / policies);
+        results[index] = playTournamentGame(config, level, seed, policy);
+    });
+    return results;
+}
+
+// Per level and policy totals, in the same order as the results
+inline std::vector<PolicySummary> summarize(const std::vector<GameResult>& results) {
+    std::vector<PolicySummary> summaries;
+    for (const GameResult& result : results) {
+        if (summaries.empty() || summaries.back().level != result.level ||
+            summaries.back().policy != result.policy) {
+            summaries.emplace_back();
+            summaries.back().level = result.level;
+            summaries.back().policy = result.policy;
+        }
+        PolicySummary& summary = summaries.back();
+        summary.games++;
+        summary.wins += result.won;
+        summary.stuckGames += result.loops > 0;
+        summary.score += result.score;
+        summary.ticks += result.ticks;
+        summary.livesLost += result.livesLost;
+        summary.wallSeconds += result.wallSeconds;
+    }
+    return summaries;
+}
+
+#endif // BLOCKBREAKER_TOURNAMENT_H